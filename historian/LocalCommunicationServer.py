@@ -23,12 +23,19 @@ import asyncio
 
 class CommunicationError(Exception): pass
 
+class _LocalSession():
+	"""Per-connection state of the status event stream."""
+	def __init__(self):
+		self.delta = False
+		self.sequence = 0
+		self.last_status = None
+
 class LocalCommunicationServer():
 	def __init__(self, historian):
 		self._historian = historian
 		self._change_event = asyncio.Event()
 
-	def _command_recentplayers(self, query = None):
+	def _command_recentplayers(self, query = None, session = None):
 		fixed_players = self._historian.config["permanent_players"]
 		recent_players = self._historian.db.get_recent_players()
 		players = list(fixed_players)
@@ -41,13 +48,13 @@ class LocalCommunicationServer():
 			"players":	players,
 		}
 
-	def _command_playerinfo(self, query):
+	def _command_playerinfo(self, query, session = None):
 		self._assert_prerequisite(("player" in query) and isinstance(query["player"], str), "'player' property not set or not of the correct type.")
 		info = self._historian.db.get_player_info(query["player"])
 		info["player"] = query["player"]
 		return info
 
-	def _command_status(self, query = None):
+	def _command_status(self, query = None, session = None):
 		return {
 			"connection": {
 				"connected_to_beatsaber":	self._historian.connected_to_beatsaber,
@@ -56,46 +63,73 @@ class LocalCommunicationServer():
 			"current_game":					self._historian.current_score.to_dict() if (self._historian.current_score is not None) else None,
 		}
 
-	def _command_set_player(self, query):
+	def _command_set_player(self, query, session = None):
 		self._assert_prerequisite(("player" in query) and isinstance(query["player"], (str, type(None))), "'player' property not set or not of the correct type.")
 		self._historian.current_player = query["player"]
 
+	def _command_set_status_mode(self, query, session = None):
+		# In delta mode, the event stream starts with a full, numbered status
+		# snapshot and afterwards only sends the fields that changed. Setting
+		# the mode again restarts it with a new snapshot, which is how clients
+		# resynchronize after they missed an update.
+		self._assert_prerequisite(("delta" in query) and isinstance(query["delta"], bool), "'delta' property not set or not of the correct type.")
+		self._assert_prerequisite(session is not None, "Status mode can only be set on a connection.")
+		session.delta = query["delta"]
+		session.last_status = None
+		self._change_event.set()
+		return {
+			"delta":	session.delta,
+		}
+
 	def _assert_prerequisite(self, condition, error_msg):
 		if not condition:
 			raise CommunicationError(error_msg)
 
-	def _process_local_command(self, query):
+	@staticmethod
+	def _request_id(query):
+		# Clients may tag commands with an integer ID that is echoed back in
+		# the response, so that they can tell which request it answers
+		if isinstance(query, dict) and isinstance(query.get("id"), int):
+			return query["id"]
+		else:
+			return None
+
+	def _process_local_command(self, query, session = None):
 		self._assert_prerequisite(isinstance(query, dict), "Invalid data type provided, expected dict.")
 		self._assert_prerequisite(("cmd" in query) and isinstance(query["cmd"], str), "No command given or command of wrong type.")
 		cmd = query["cmd"]
 		handler = getattr(self, "_command_%s" % (cmd), None)
 		if handler is None:
 			raise CommunicationError("No such command: \"%s\"" % (cmd))
-		response = handler(query)
+		response = handler(query, session)
 		if response is not None:
 			response["msgtype"] = cmd
+			request_id = self._request_id(query)
+			if request_id is not None:
+				response["id"] = request_id
 		return response
 
-	def _process_local_raw_command(self, raw_query):
-		query = json.loads(raw_query)
-		return self._process_local_command(query)
-
 	async def _respond(self, writer, response):
 		writer.write((json.dumps(response) + "\n").encode("ascii"))
 
-	async def _local_server_commands(self, reader, writer):
+	async def _local_server_commands(self, reader, writer, session):
 		try:
 			while not writer.is_closing():
 				msg = await reader.readline()
 				if len(msg) == 0:
 					break
+				query = None
 				try:
-					response = self._process_local_raw_command(msg)
+					query = json.loads(msg)
+					response = self._process_local_command(query, session)
 				except (CommunicationError, json.decoder.JSONDecodeError) as e:
 					response = {
 						"msgtype":	"error",
 						"text":		str(e),
 					}
+					request_id = self._request_id(query)
+					if request_id is not None:
+						response["id"] = request_id
 				if response is not None:
 					await self._respond(writer, response)
 		except (ConnectionResetError, BrokenPipeError) as e:
@@ -105,17 +139,59 @@ class LocalCommunicationServer():
 	def change_event(self):
 		self._change_event.set()
 
-	async def _local_server_events(self, reader, writer):
+	@classmethod
+	def _status_delta(cls, old, new):
+		# Nested dictionaries only contain the changed leaves, keys that have
+		# disappeared are sent as None
+		delta = { }
+		for (key, value) in new.items():
+			old_value = old.get(key)
+			if isinstance(value, dict) and isinstance(old_value, dict):
+				nested_delta = cls._status_delta(old_value, value)
+				if len(nested_delta) > 0:
+					delta[key] = nested_delta
+			elif (key not in old) or (value != old_value):
+				delta[key] = value
+		for key in old:
+			if key not in new:
+				delta[key] = None
+		return delta
+
+	def _status_update(self, session):
+		status = self._process_local_command({ "cmd": "status" })
+		if not session.delta:
+			return status
+
+		previous_status = session.last_status
+		if previous_status is None:
+			update = dict(status)
+		else:
+			changes = self._status_delta(previous_status, status)
+			if len(changes) == 0:
+				return None
+			update = {
+				"msgtype":	"status_delta",
+				"changes":	changes,
+			}
+		session.sequence += 1
+		session.last_status = status
+		update["seq"] = session.sequence
+		return update
+
+	async def _local_server_events(self, reader, writer, session):
 		self._change_event.set()
 		while not writer.is_closing():
 			await self._change_event.wait()
 			self._change_event.clear()
-			await self._respond(writer, self._process_local_command({ "cmd": "status" }))
+			update = self._status_update(session)
+			if update is not None:
+				await self._respond(writer, update)
 
 	async def _local_server_tasks(self, reader, writer):
+		session = _LocalSession()
 		await asyncio.gather(
-			self._local_server_commands(reader, writer),
-			self._local_server_events(reader, writer),
+			self._local_server_commands(reader, writer, session),
+			self._local_server_events(reader, writer, session),
 		)
 		writer.close()
 
@@ -25,28 +25,135 @@
 #include <string.h>
 #include <stdarg.h>
 #include <math.h>
+#include <pthread.h>
 #include <fontconfig/fontconfig.h>
 #include "cairo.h"
+#include "textcache.h"
+
+#define FONT_CACHE_ENTRIES				32
+#define TEXT_RUN_PAD					2
+#define GLYPH_ATLAS_CHARSET				"0123456789%.,:+- "
+#define GLYPH_ATLAS_GLYPH_COUNT			(sizeof(GLYPH_ATLAS_CHARSET) - 1)
+#define GLYPH_ATLAS_MAX_COUNT			32
+
+struct font_cache_entry_t {
+	char font_face[64];
+	unsigned int font_size;
+	bool font_bold;
+	cairo_scaled_font_t *scaled_font;
+	cairo_font_extents_t font_extents;
+};
+
+/* A font resolved through the font cache; holds its own reference to the
+ * scaled font and must be released after use */
+struct swbuf_font_t {
+	cairo_scaled_font_t *scaled_font;
+	cairo_font_extents_t extents;
+};
+
+static struct {
+	pthread_mutex_t mutex;
+	unsigned int entry_count;
+	unsigned int next_eviction;
+	struct font_cache_entry_t entries[FONT_CACHE_ENTRIES];
+	struct font_cache_stats_t stats;
+} font_cache = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static struct textcache_t text_cache = TEXTCACHE_INITIALIZER(TEXTCACHE_DEFAULT_MEMORY_LIMIT);
+
+struct glyph_atlas_glyph_t {
+	int cell_x;
+	int cell_width;
+	cairo_text_extents_t extents;
+};
+
+/* All glyphs of GLYPH_ATLAS_CHARSET rasterized side by side in one surface,
+ * sharing a common baseline. Atlases are immutable once created. */
+struct glyph_atlas_t {
+	char font_face[64];
+	unsigned int font_size;
+	bool font_bold;
+	uint32_t font_color;
+	double font_ascent;
+	int y_bearing;
+	int cell_height;
+	cairo_surface_t *surface;
+	struct glyph_atlas_glyph_t glyphs[GLYPH_ATLAS_GLYPH_COUNT];
+};
+
+static struct {
+	pthread_mutex_t mutex;
+	unsigned int atlas_count;
+	struct glyph_atlas_t atlases[GLYPH_ATLAS_MAX_COUNT];
+	unsigned long strings_composed;
+} glyph_atlases = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/* 16 bpp displays get RGB565 buffers, so frames can be copied out without any
+ * conversion; everything else renders in ARGB32 */
+static cairo_format_t swbuf_format_for_bpp(unsigned int bits_per_pixel) {
+	return (bits_per_pixel == 16) ? CAIRO_FORMAT_RGB16_565 : CAIRO_FORMAT_ARGB32;
+}
+
+static struct cairo_swbuf_t *create_swbuf_for_surface(cairo_surface_t *surface, unsigned int width, unsigned int height, double scale) {
+	if (!surface) {
+		return NULL;
+	}
+	if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+		fprintf(stderr, "Cannot create %u x %u surface: %s\n", width, height, cairo_status_to_string(cairo_surface_status(surface)));
+		cairo_surface_destroy(surface);
+		return NULL;
+	}
 
-struct cairo_swbuf_t *create_swbuf(unsigned int width, unsigned int height) {
 	struct cairo_swbuf_t *buffer = calloc(sizeof(struct cairo_swbuf_t), 1);
 	if (!buffer) {
 		perror("calloc");
+		cairo_surface_destroy(surface);
 		return NULL;
 	}
 
 	buffer->width = width;
 	buffer->height = height;
-	buffer->surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
-	if (!buffer->surface) {
-		free_swbuf(buffer);
-		return NULL;
+	buffer->scale = scale;
+	buffer->pixel_width = cairo_image_surface_get_width(surface);
+	buffer->pixel_height = cairo_image_surface_get_height(surface);
+	buffer->surface = surface;
+	buffer->format = cairo_image_surface_get_format(surface);
+	if (scale != 1) {
+		cairo_surface_set_device_scale(surface, scale, scale);
 	}
-
 	buffer->ctx = cairo_create(buffer->surface);
+	buffer->tracking.enabled = true;
+	buffer->tracking.full_redraw = true;
 	return buffer;
 }
 
+struct cairo_swbuf_t *create_swbuf(unsigned int width, unsigned int height) {
+	return create_swbuf_for_bpp(width, height, 32);
+}
+
+struct cairo_swbuf_t *create_swbuf_for_bpp(unsigned int width, unsigned int height, unsigned int bits_per_pixel) {
+	return create_swbuf_scaled(width, height, bits_per_pixel, 1);
+}
+
+/* Everything is laid out in width x height, but rasterized into a pixel buffer
+ * that is smaller (or larger) by the given factor. Device scaling of the
+ * surface takes care of all placements. */
+struct cairo_swbuf_t *create_swbuf_scaled(unsigned int width, unsigned int height, unsigned int bits_per_pixel, double scale) {
+	const unsigned int pixel_width = ceil(width * scale);
+	const unsigned int pixel_height = ceil(height * scale);
+	return create_swbuf_for_surface(cairo_image_surface_create(swbuf_format_for_bpp(bits_per_pixel), pixel_width, pixel_height), width, height, scale);
+}
+
+/* Renders into memory owned by the caller (e.g., a mapped framebuffer page)
+ * instead of a private pixel buffer. The memory must outlive the swbuf. */
+struct cairo_swbuf_t *create_swbuf_for_data(uint8_t *data, unsigned int width, unsigned int height, unsigned int stride, unsigned int bits_per_pixel) {
+	return create_swbuf_for_surface(cairo_image_surface_create_for_data(data, swbuf_format_for_bpp(bits_per_pixel), width, height, stride), width, height, 1);
+}
+
 static void swbuf_set_source_rgb(struct cairo_swbuf_t *surface, uint32_t bgcolor) {
 	cairo_set_source_rgb(surface->ctx, GET_R(bgcolor) / 255.0, GET_G(bgcolor) / 255.0, GET_B(bgcolor) / 255.0);
 }
@@ -57,13 +164,30 @@ void swbuf_clear(struct cairo_swbuf_t *surface, uint32_t bgcolor) {
 	cairo_fill(surface->ctx);
 }
 
-uint32_t* swbuf_get_pixel_data(const struct cairo_swbuf_t *surface) {
-	return (uint32_t*)cairo_image_surface_get_data(surface->surface);
+uint8_t* swbuf_get_pixel_data(const struct cairo_swbuf_t *surface) {
+	return cairo_image_surface_get_data(surface->surface);
 }
 
+unsigned int swbuf_get_stride(const struct cairo_swbuf_t *surface) {
+	return cairo_image_surface_get_stride(surface->surface);
+}
+
+unsigned int swbuf_get_bits_per_pixel(const struct cairo_swbuf_t *surface) {
+	return (surface->format == CAIRO_FORMAT_RGB16_565) ? 16 : 32;
+}
+
+/* Always returns 24 bit RGB, regardless of the buffer's format; x and y are
+ * pixel coordinates, which differ from layout coordinates on scaled buffers */
 uint32_t swbuf_get_pixel(const struct cairo_swbuf_t *surface, unsigned int x, unsigned int y) {
-	const uint32_t *data = swbuf_get_pixel_data(surface);
-	return data[(y * surface->width) + x] & 0xffffff;
+	const uint8_t *row = swbuf_get_pixel_data(surface) + (y * swbuf_get_stride(surface));
+	if (surface->format == CAIRO_FORMAT_RGB16_565) {
+		const uint16_t pixel = ((const uint16_t*)row)[x];
+		const uint8_t r = (pixel >> 11) & 0x1f;
+		const uint8_t g = (pixel >> 5) & 0x3f;
+		const uint8_t b = (pixel >> 0) & 0x1f;
+		return MK_RGB((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+	}
+	return ((const uint32_t*)row)[x] & 0xffffff;
 }
 
 #ifdef CAIRO_DEBUG
@@ -198,50 +322,471 @@ static struct placement_t swbuf_calculate_placement(const struct cairo_swbuf_t *
 	return placement;
 }
 
-void swbuf_render_table(struct cairo_swbuf_t *surface, const struct table_definition_t *table, void *ctx) {
-	const unsigned int table_height = table->row_height * table->rows;
-	unsigned int table_width = 0;
-	for (unsigned int x = 0; x < table->columns; x++) {
-		table_width += table->column_widths[x];
+static bool anchored_placement_equal(const struct anchored_placement_t *a, const struct anchored_placement_t *b) {
+	return (a->xoffset == b->xoffset) && (a->yoffset == b->yoffset)
+		&& (a->dst_anchor.x == b->dst_anchor.x) && (a->dst_anchor.y == b->dst_anchor.y)
+		&& (a->src_anchor.x == b->src_anchor.x) && (a->src_anchor.y == b->src_anchor.y);
+}
+
+static bool font_placement_equal(const struct font_placement_t *a, const struct font_placement_t *b) {
+	if (a->font_face != b->font_face) {
+		if (!a->font_face || !b->font_face || strcmp(a->font_face, b->font_face)) {
+			return false;
+		}
 	}
-	struct placement_t table_placement = swbuf_calculate_placement(surface, &table->anchor, table_width, table_height);
+	return anchored_placement_equal(&a->placement, &b->placement)
+		&& (a->font_size == b->font_size) && (a->font_color == b->font_color) && (a->font_bold == b->font_bold)
+		&& (a->last_width == b->last_width) && (a->max_width_deviation == b->max_width_deviation);
+}
 
-	unsigned int base_x = 0;
-	for (unsigned int x = 0; x < table->columns; x++) {
-		for (unsigned int y = 0; y < table->rows; y++) {
-			unsigned int base_y = table->row_height * y;
-			struct font_placement_t placement = table->font_default;
-			placement.placement.xoffset = table_placement.top_left.x + base_x;
-			placement.placement.yoffset = table_placement.top_left.y + base_y;
+static bool rect_placement_equal(const struct rect_placement_t *a, const struct rect_placement_t *b) {
+	return anchored_placement_equal(&a->placement, &b->placement)
+		&& (a->width == b->width) && (a->height == b->height) && (a->round == b->round)
+		&& (a->color == b->color) && (a->fill == b->fill);
+}
 
-			char buffer[256];
-			buffer[0] = 0;
-			table->rendering_callback(buffer, sizeof(buffer), &placement, x, y, ctx);
-			swbuf_text(surface, &placement, "%s", buffer);
+static bool swbuf_widget_equal(const struct swbuf_widget_t *a, const struct swbuf_widget_t *b) {
+	if (a->type != b->type) {
+		return false;
+	}
+	switch (a->type) {
+		case WIDGET_TEXT:
+			return font_placement_equal(&a->placement.font, &b->placement.font) && !strcmp(a->text, b->text);
+
+		case WIDGET_RECT:
+			return rect_placement_equal(&a->placement.rect, &b->placement.rect);
+	}
+	return false;
+}
+
+static bool placement_overlaps(const struct placement_t *a, const struct placement_t *b) {
+	return (a->top_left.x <= b->bottom_right.x) && (b->top_left.x <= a->bottom_right.x)
+		&& (a->top_left.y <= b->bottom_right.y) && (b->top_left.y <= a->bottom_right.y);
+}
+
+static void placement_union(struct placement_t *dst, const struct placement_t *src) {
+	dst->top_left.x = (src->top_left.x < dst->top_left.x) ? src->top_left.x : dst->top_left.x;
+	dst->top_left.y = (src->top_left.y < dst->top_left.y) ? src->top_left.y : dst->top_left.y;
+	dst->bottom_right.x = (src->bottom_right.x > dst->bottom_right.x) ? src->bottom_right.x : dst->bottom_right.x;
+	dst->bottom_right.y = (src->bottom_right.y > dst->bottom_right.y) ? src->bottom_right.y : dst->bottom_right.y;
+}
+
+static void swbuf_damage_add(const struct cairo_swbuf_t *surface, struct swbuf_damage_t *damage, const struct placement_t *rect) {
+	struct placement_t clipped = *rect;
+	clipped.top_left.x = (clipped.top_left.x < 0) ? 0 : clipped.top_left.x;
+	clipped.top_left.y = (clipped.top_left.y < 0) ? 0 : clipped.top_left.y;
+	clipped.bottom_right.x = (clipped.bottom_right.x > (int)surface->width) ? (int)surface->width : clipped.bottom_right.x;
+	clipped.bottom_right.y = (clipped.bottom_right.y > (int)surface->height) ? (int)surface->height : clipped.bottom_right.y;
+	if ((clipped.top_left.x >= clipped.bottom_right.x) || (clipped.top_left.y >= clipped.bottom_right.y)) {
+		return;
+	}
+
+	/* Swallow all rectangles that overlap the new one; since the new one
+	 * grows while doing so, restart the search after every merge */
+	unsigned int i = 0;
+	while (i < damage->rect_count) {
+		if (placement_overlaps(&damage->rects[i], &clipped)) {
+			placement_union(&clipped, &damage->rects[i]);
+			damage->rects[i] = damage->rects[--damage->rect_count];
+			i = 0;
+		} else {
+			i++;
 		}
-		base_x += table->column_widths[x];
 	}
+
+	if (damage->rect_count == SWBUF_MAX_DAMAGE_RECTS) {
+		/* Too fragmented, collapse everything into one bounding box */
+		for (i = 0; i < damage->rect_count; i++) {
+			placement_union(&clipped, &damage->rects[i]);
+		}
+		damage->rect_count = 0;
+	}
+	damage->rects[damage->rect_count++] = clipped;
 }
 
-unsigned int swbuf_text(struct cairo_swbuf_t *surface, const struct font_placement_t *placement, const char *fmt, ...) {
-	char text[512];
-	va_list ap;
-	va_start(ap, fmt);
-	vsnprintf(text, sizeof(text), fmt, ap);
-	va_end(ap);
+static void swbuf_damage_add_all(const struct cairo_swbuf_t *surface, struct swbuf_damage_t *damage) {
+	swbuf_damage_add(surface, damage, &(const struct placement_t) {
+		.bottom_right = {
+			.x = surface->width,
+			.y = surface->height,
+		},
+	});
+}
 
-	if (!placement->font_size) {
-		fprintf(stderr, "Warning: Font size zero. Not rendered: \"%s\"\n", text);
-		return 0;
+static void swbuf_damage_diff(const struct cairo_swbuf_t *surface, struct swbuf_damage_t *damage, const struct swbuf_widget_list_t *old_list, const struct swbuf_widget_list_t *new_list) {
+	const unsigned int widget_count = (new_list->count > old_list->count) ? new_list->count : old_list->count;
+	for (unsigned int i = 0; i < widget_count; i++) {
+		const struct swbuf_widget_t *old_widget = (i < old_list->count) ? &old_list->widgets[i] : NULL;
+		const struct swbuf_widget_t *new_widget = (i < new_list->count) ? &new_list->widgets[i] : NULL;
+		if (old_widget && new_widget && swbuf_widget_equal(old_widget, new_widget)) {
+			continue;
+		}
+		if (old_widget) {
+			swbuf_damage_add(surface, damage, &old_widget->extents);
+		}
+		if (new_widget) {
+			swbuf_damage_add(surface, damage, &new_widget->extents);
+		}
 	}
+}
 
-	cairo_text_extents_t extents;
-	cairo_select_font_face(surface->ctx, placement->font_face, CAIRO_FONT_SLANT_NORMAL, placement->font_bold ? CAIRO_FONT_WEIGHT_BOLD : CAIRO_FONT_WEIGHT_NORMAL);
-	cairo_set_font_size(surface->ctx, placement->font_size);
-	cairo_text_extents(surface->ctx, text, &extents);
+static bool swbuf_damage_intersects(const struct swbuf_damage_t *damage, const struct placement_t *rect) {
+	for (unsigned int i = 0; i < damage->rect_count; i++) {
+		if (placement_overlaps(&damage->rects[i], rect)) {
+			return true;
+		}
+	}
+	return false;
+}
 
+static struct swbuf_widget_t *swbuf_widget_list_append(struct swbuf_widget_list_t *list) {
+	if (list->count == list->capacity) {
+		unsigned int new_capacity = list->capacity ? (2 * list->capacity) : 64;
+		struct swbuf_widget_t *new_widgets = realloc(list->widgets, sizeof(struct swbuf_widget_t) * new_capacity);
+		if (!new_widgets) {
+			perror("realloc");
+			return NULL;
+		}
+		list->widgets = new_widgets;
+		list->capacity = new_capacity;
+	}
+	return &list->widgets[list->count++];
+}
+
+/* Returns the widget drawn at the same position in the previous frame if it
+ * had exactly the same inputs, NULL otherwise */
+static const struct swbuf_widget_t *swbuf_unchanged_widget(const struct cairo_swbuf_t *surface, const struct swbuf_widget_t *widget) {
+	unsigned int index = widget - surface->tracking.current.widgets;
+	if (index >= surface->tracking.drawn.count) {
+		return NULL;
+	}
+	const struct swbuf_widget_t *previous = &surface->tracking.drawn.widgets[index];
+	return swbuf_widget_equal(previous, widget) ? previous : NULL;
+}
+
+static struct font_cache_entry_t *font_cache_find(const struct font_placement_t *placement) {
+	for (unsigned int i = 0; i < font_cache.entry_count; i++) {
+		struct font_cache_entry_t *entry = &font_cache.entries[i];
+		if ((entry->font_size == placement->font_size) && (entry->font_bold == placement->font_bold) && !strcmp(entry->font_face, placement->font_face)) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+static struct font_cache_entry_t *font_cache_insert(struct cairo_swbuf_t *surface, const struct font_placement_t *placement) {
+	cairo_font_face_t *font_face = cairo_toy_font_face_create(placement->font_face, CAIRO_FONT_SLANT_NORMAL, placement->font_bold ? CAIRO_FONT_WEIGHT_BOLD : CAIRO_FONT_WEIGHT_NORMAL);
+	cairo_matrix_t font_matrix, ctm;
+	cairo_matrix_init_scale(&font_matrix, placement->font_size, placement->font_size);
+	cairo_matrix_init_identity(&ctm);
+	cairo_font_options_t *options = cairo_font_options_create();
+	cairo_surface_get_font_options(surface->surface, options);
+	cairo_scaled_font_t *scaled_font = cairo_scaled_font_create(font_face, &font_matrix, &ctm, options);
+	cairo_font_options_destroy(options);
+	cairo_font_face_destroy(font_face);
+	if (cairo_scaled_font_status(scaled_font) != CAIRO_STATUS_SUCCESS) {
+		fprintf(stderr, "Could not create scaled font %s at %u pt.\n", placement->font_face, placement->font_size);
+		cairo_scaled_font_destroy(scaled_font);
+		return NULL;
+	}
+
+	struct font_cache_entry_t *entry;
+	if (font_cache.entry_count < FONT_CACHE_ENTRIES) {
+		entry = &font_cache.entries[font_cache.entry_count++];
+	} else {
+		/* Cache is full, replace entries round-robin. Fonts that are still in
+		 * use keep their own reference. */
+		entry = &font_cache.entries[font_cache.next_eviction];
+		font_cache.next_eviction = (font_cache.next_eviction + 1) % FONT_CACHE_ENTRIES;
+		cairo_scaled_font_destroy(entry->scaled_font);
+	}
+	strncpy(entry->font_face, placement->font_face, sizeof(entry->font_face) - 1);
+	entry->font_face[sizeof(entry->font_face) - 1] = 0;
+	entry->font_size = placement->font_size;
+	entry->font_bold = placement->font_bold;
+	entry->scaled_font = scaled_font;
+	cairo_scaled_font_extents(scaled_font, &entry->font_extents);
+	return entry;
+}
+
+static bool swbuf_font_acquire(struct cairo_swbuf_t *surface, const struct font_placement_t *placement, struct swbuf_font_t *font) {
+	pthread_mutex_lock(&font_cache.mutex);
+	font_cache.stats.lookups++;
+	struct font_cache_entry_t *entry = font_cache_find(placement);
+	if (entry) {
+		font_cache.stats.hits++;
+	} else {
+		entry = font_cache_insert(surface, placement);
+	}
+	if (entry) {
+		font->scaled_font = cairo_scaled_font_reference(entry->scaled_font);
+		font->extents = entry->font_extents;
+	}
+	pthread_mutex_unlock(&font_cache.mutex);
+	return entry != NULL;
+}
+
+static void swbuf_font_release(struct swbuf_font_t *font) {
+	cairo_scaled_font_destroy(font->scaled_font);
+	font->scaled_font = NULL;
+}
+
+void swbuf_get_font_cache_stats(struct font_cache_stats_t *stats) {
+	pthread_mutex_lock(&font_cache.mutex);
+	*stats = font_cache.stats;
+	pthread_mutex_unlock(&font_cache.mutex);
+}
+
+void swbuf_set_text_cache_limit(size_t memory_limit) {
+	textcache_set_memory_limit(&text_cache, memory_limit);
+}
+
+void swbuf_print_cache_stats(void) {
+	struct font_cache_stats_t stats;
+	swbuf_get_font_cache_stats(&stats);
+	fprintf(stderr, "Font cache: %lu lookups, %lu hits (%.1f%%), %lu fonts resolved\n", stats.lookups, stats.hits, stats.lookups ? 100. * stats.hits / stats.lookups : 100., stats.lookups - stats.hits);
+
+	struct textcache_stats_t text_stats;
+	textcache_get_stats(&text_cache, &text_stats);
+	fprintf(stderr, "Text run cache: %lu lookups, %lu hits (%.1f%%), %lu evictions, %u runs using %zu of %zu kB\n", text_stats.lookups, text_stats.hits, text_stats.lookups ? 100. * text_stats.hits / text_stats.lookups : 100., text_stats.evictions, text_stats.entry_count, text_stats.memory_used / 1024, text_stats.memory_limit / 1024);
+
+	pthread_mutex_lock(&glyph_atlases.mutex);
+	fprintf(stderr, "Glyph atlas: %lu strings composed from %u atlases\n", glyph_atlases.strings_composed, glyph_atlases.atlas_count);
+	pthread_mutex_unlock(&glyph_atlases.mutex);
+}
+
+static bool glyph_atlas_can_render(const char *text) {
+	return text[0] && (text[strspn(text, GLYPH_ATLAS_CHARSET)] == 0);
+}
+
+static const struct glyph_atlas_glyph_t *glyph_atlas_glyph(const struct glyph_atlas_t *atlas, char c) {
+	return &atlas->glyphs[strchr(GLYPH_ATLAS_CHARSET, c) - GLYPH_ATLAS_CHARSET];
+}
+
+static bool glyph_atlas_create(struct cairo_swbuf_t *surface, struct glyph_atlas_t *atlas, const struct font_placement_t *placement) {
+	struct swbuf_font_t font;
+	if (!swbuf_font_acquire(surface, placement, &font)) {
+		return false;
+	}
+
+	cairo_glyph_t glyph_ids[GLYPH_ATLAS_GLYPH_COUNT];
+	double min_y_bearing = 0, max_y_extent = 0;
+	int atlas_width = 0;
+	for (unsigned int i = 0; i < GLYPH_ATLAS_GLYPH_COUNT; i++) {
+		cairo_glyph_t *glyphs = NULL;
+		int glyph_count = 0;
+		if ((cairo_scaled_font_text_to_glyphs(font.scaled_font, 0, 0, GLYPH_ATLAS_CHARSET + i, 1, &glyphs, &glyph_count, NULL, NULL, NULL) != CAIRO_STATUS_SUCCESS) || (glyph_count != 1)) {
+			cairo_glyph_free(glyphs);
+			swbuf_font_release(&font);
+			return false;
+		}
+		glyph_ids[i] = glyphs[0];
+		cairo_glyph_free(glyphs);
+
+		struct glyph_atlas_glyph_t *glyph = &atlas->glyphs[i];
+		cairo_scaled_font_glyph_extents(font.scaled_font, &glyph_ids[i], 1, &glyph->extents);
+		glyph->cell_x = atlas_width;
+		glyph->cell_width = ceil(glyph->extents.x_bearing - floor(glyph->extents.x_bearing) + glyph->extents.width) + (2 * TEXT_RUN_PAD);
+		atlas_width += glyph->cell_width;
+		if (glyph->extents.y_bearing < min_y_bearing) {
+			min_y_bearing = glyph->extents.y_bearing;
+		}
+		if (glyph->extents.y_bearing + glyph->extents.height > max_y_extent) {
+			max_y_extent = glyph->extents.y_bearing + glyph->extents.height;
+		}
+	}
+
+	atlas->y_bearing = floor(min_y_bearing);
+	atlas->cell_height = ceil(max_y_extent - atlas->y_bearing) + (2 * TEXT_RUN_PAD);
+	atlas->surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, atlas_width, atlas->cell_height);
+	if (cairo_surface_status(atlas->surface) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy(atlas->surface);
+		swbuf_font_release(&font);
+		return false;
+	}
+
+	cairo_t *ctx = cairo_create(atlas->surface);
+	cairo_set_scaled_font(ctx, font.scaled_font);
+	cairo_set_source_rgb(ctx, GET_R(placement->font_color) / 255.0, GET_G(placement->font_color) / 255.0, GET_B(placement->font_color) / 255.0);
+	for (unsigned int i = 0; i < GLYPH_ATLAS_GLYPH_COUNT; i++) {
+		const struct glyph_atlas_glyph_t *glyph = &atlas->glyphs[i];
+		glyph_ids[i].x = glyph->cell_x + TEXT_RUN_PAD - floor(glyph->extents.x_bearing);
+		glyph_ids[i].y = TEXT_RUN_PAD - atlas->y_bearing;
+		cairo_show_glyphs(ctx, &glyph_ids[i], 1);
+	}
+	cairo_destroy(ctx);
+	cairo_surface_flush(atlas->surface);
+
+	strncpy(atlas->font_face, placement->font_face, sizeof(atlas->font_face) - 1);
+	atlas->font_size = placement->font_size;
+	atlas->font_bold = placement->font_bold;
+	atlas->font_color = placement->font_color;
+	atlas->font_ascent = font.extents.ascent;
+	swbuf_font_release(&font);
+	return true;
+}
+
+/* Returns NULL if no atlas exists and none can be created anymore; callers
+ * then need to take the regular text path */
+static const struct glyph_atlas_t *glyph_atlas_get(struct cairo_swbuf_t *surface, const struct font_placement_t *placement) {
+	const struct glyph_atlas_t *result = NULL;
+	pthread_mutex_lock(&glyph_atlases.mutex);
+	for (unsigned int i = 0; i < glyph_atlases.atlas_count; i++) {
+		const struct glyph_atlas_t *atlas = &glyph_atlases.atlases[i];
+		if ((atlas->font_size == placement->font_size) && (atlas->font_bold == placement->font_bold) && (atlas->font_color == placement->font_color) && !strcmp(atlas->font_face, placement->font_face)) {
+			result = atlas;
+			break;
+		}
+	}
+	if (!result && (glyph_atlases.atlas_count < GLYPH_ATLAS_MAX_COUNT)) {
+		struct glyph_atlas_t *atlas = &glyph_atlases.atlases[glyph_atlases.atlas_count];
+		if (glyph_atlas_create(surface, atlas, placement)) {
+			glyph_atlases.atlas_count++;
+			result = atlas;
+		}
+	}
+	pthread_mutex_unlock(&glyph_atlases.mutex);
+	return result;
+}
+
+/* Same semantics as cairo_text_extents(), which does not kern either */
+static void glyph_atlas_text_extents(const struct glyph_atlas_t *atlas, const char *text, cairo_text_extents_t *extents) {
+	double pen_x = 0;
+	bool have_ink = false;
+	double min_x = 0, max_x = 0, min_y = 0, max_y = 0;
+	for (const char *c = text; *c; c++) {
+		const struct glyph_atlas_glyph_t *glyph = glyph_atlas_glyph(atlas, *c);
+		if ((glyph->extents.width > 0) && (glyph->extents.height > 0)) {
+			const double x0 = pen_x + glyph->extents.x_bearing;
+			const double x1 = x0 + glyph->extents.width;
+			const double y0 = glyph->extents.y_bearing;
+			const double y1 = y0 + glyph->extents.height;
+			if (!have_ink) {
+				have_ink = true;
+				min_x = x0;
+				max_x = x1;
+				min_y = y0;
+				max_y = y1;
+			} else {
+				min_x = (x0 < min_x) ? x0 : min_x;
+				max_x = (x1 > max_x) ? x1 : max_x;
+				min_y = (y0 < min_y) ? y0 : min_y;
+				max_y = (y1 > max_y) ? y1 : max_y;
+			}
+		}
+		pen_x += glyph->extents.x_advance;
+	}
+	extents->x_bearing = min_x;
+	extents->y_bearing = min_y;
+	extents->width = max_x - min_x;
+	extents->height = max_y - min_y;
+	extents->x_advance = pen_x;
+	extents->y_advance = 0;
+}
+
+static void glyph_atlas_draw(struct cairo_swbuf_t *surface, const struct glyph_atlas_t *atlas, const char *text, double origin_x, double origin_y) {
+	const int cell_y = lround(origin_y) + atlas->y_bearing - TEXT_RUN_PAD;
+	double pen_x = origin_x;
+	for (const char *c = text; *c; c++) {
+		const struct glyph_atlas_glyph_t *glyph = glyph_atlas_glyph(atlas, *c);
+		if (glyph->extents.width > 0) {
+			const int dst_x = lround(pen_x) + (int)floor(glyph->extents.x_bearing) - TEXT_RUN_PAD;
+			cairo_set_source_surface(surface->ctx, atlas->surface, dst_x - glyph->cell_x, cell_y);
+			cairo_rectangle(surface->ctx, dst_x, cell_y, glyph->cell_width, atlas->cell_height);
+			cairo_fill(surface->ctx);
+		}
+		pen_x += glyph->extents.x_advance;
+	}
+
+	pthread_mutex_lock(&glyph_atlases.mutex);
+	glyph_atlases.strings_composed++;
+	pthread_mutex_unlock(&glyph_atlases.mutex);
+}
+
+static struct textcache_key_t swbuf_text_cache_key(const struct swbuf_widget_t *widget) {
+	const struct font_placement_t *placement = &widget->placement.font;
+	return (struct textcache_key_t) {
+		.font_face = placement->font_face,
+		.font_size = placement->font_size,
+		.font_color = placement->font_color,
+		.font_bold = placement->font_bold,
+		.text = widget->text,
+	};
+}
+
+static bool swbuf_text_extents(struct cairo_swbuf_t *surface, const struct swbuf_widget_t *widget, cairo_text_extents_t *extents, double *font_ascent) {
+	if ((surface->scale == 1) && glyph_atlas_can_render(widget->text)) {
+		const struct glyph_atlas_t *atlas = glyph_atlas_get(surface, &widget->placement.font);
+		if (atlas) {
+			glyph_atlas_text_extents(atlas, widget->text, extents);
+			*font_ascent = atlas->font_ascent;
+			return true;
+		}
+	}
+
+	/* A cached run already knows its extents */
+	const struct textcache_key_t key = swbuf_text_cache_key(widget);
+	struct textcache_run_t run;
+	if (textcache_lookup(&text_cache, &key, &run)) {
+		*extents = run.extents;
+		*font_ascent = run.font_ascent;
+		cairo_surface_destroy(run.surface);
+		return true;
+	}
+
+	struct swbuf_font_t font;
+	if (!swbuf_font_acquire(surface, &widget->placement.font, &font)) {
+		return false;
+	}
+	cairo_scaled_font_text_extents(font.scaled_font, widget->text, extents);
+	*font_ascent = font.extents.ascent;
+	swbuf_font_release(&font);
+	return true;
+}
+
+static bool swbuf_rasterize_text_run(struct cairo_swbuf_t *surface, const struct swbuf_widget_t *widget, struct textcache_run_t *run) {
+	const struct font_placement_t *placement = &widget->placement.font;
+	struct swbuf_font_t font;
+	if (!swbuf_font_acquire(surface, placement, &font)) {
+		return false;
+	}
+	cairo_scaled_font_text_extents(font.scaled_font, widget->text, &run->extents);
+	run->font_ascent = font.extents.ascent;
+	run->pad = TEXT_RUN_PAD;
+
+	/* Keep the subpixel vertical offset of the glyphs identical to drawing
+	 * them directly on the baseline */
+	const double y_bearing = floor(run->extents.y_bearing);
+	const int width = ceil(run->extents.width) + (2 * run->pad);
+	const int height = ceil(run->extents.height + run->extents.y_bearing - y_bearing) + (2 * run->pad);
+	run->surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+	if (cairo_surface_status(run->surface) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy(run->surface);
+		swbuf_font_release(&font);
+		return false;
+	}
+
+	cairo_t *ctx = cairo_create(run->surface);
+	cairo_set_scaled_font(ctx, font.scaled_font);
+	cairo_set_source_rgb(ctx, GET_R(placement->font_color) / 255.0, GET_G(placement->font_color) / 255.0, GET_B(placement->font_color) / 255.0);
+	cairo_move_to(ctx, run->pad - run->extents.x_bearing, run->pad - y_bearing);
+	cairo_show_text(ctx, widget->text);
+	cairo_destroy(ctx);
+	cairo_surface_flush(run->surface);
+	swbuf_font_release(&font);
+	return true;
+}
+
+static void swbuf_text_measure(struct cairo_swbuf_t *surface, struct swbuf_widget_t *widget) {
+	const struct font_placement_t *placement = &widget->placement.font;
+
+	cairo_text_extents_t extents;
 	cairo_font_extents_t font_extents;
-	cairo_font_extents(surface->ctx, &font_extents);
+	if (!swbuf_text_extents(surface, widget, &extents, &font_extents.ascent)) {
+		memset(&widget->extents, 0, sizeof(widget->extents));
+		widget->text_width = 0;
+		return;
+	}
 
 	unsigned int assumed_width = extents.width;
 	if (placement->last_width) {
@@ -255,28 +800,112 @@ unsigned int swbuf_text(struct cairo_swbuf_t *surface, const struct font_placeme
 	}
 
 	struct placement_t abs_placement = swbuf_calculate_placement(surface, &placement->placement, assumed_width, font_extents.ascent);
+	widget->text_width = assumed_width;
+	widget->origin_x = abs_placement.top_left.x - extents.x_bearing;
+	widget->origin_y = abs_placement.bottom_right.y;
+
+	/* Ink bounding box, padded for antialiasing */
+	widget->extents.top_left.x = floor(widget->origin_x + extents.x_bearing) - 2;
+	widget->extents.top_left.y = floor(widget->origin_y + extents.y_bearing) - 2;
+	widget->extents.bottom_right.x = ceil(widget->origin_x + extents.x_bearing + extents.width) + 2;
+	widget->extents.bottom_right.y = ceil(widget->origin_y + extents.y_bearing + extents.height) + 2;
+#if CAIRO_DEBUG
+	widget->debug_placement = abs_placement;
+	widget->debug_placement.bottom_right.x = abs_placement.top_left.x + extents.width;
+#endif
+}
+
+static void swbuf_text_run_draw(struct cairo_swbuf_t *surface, const struct swbuf_widget_t *widget) {
+	const struct textcache_key_t key = swbuf_text_cache_key(widget);
+	struct textcache_run_t run;
+	if (!textcache_lookup(&text_cache, &key, &run)) {
+		if (!swbuf_rasterize_text_run(surface, widget, &run)) {
+			return;
+		}
+		textcache_insert(&text_cache, &key, &run);
+	}
+
+	/* The run's ink starts exactly at the integer position the text was
+	 * placed at, so this is a plain blit */
+	const int blit_x = lround(widget->origin_x + run.extents.x_bearing) - run.pad;
+	const int blit_y = lround(widget->origin_y + floor(run.extents.y_bearing)) - run.pad;
+	cairo_set_source_surface(surface->ctx, run.surface, blit_x, blit_y);
+	cairo_paint(surface->ctx);
+	cairo_surface_destroy(run.surface);
+}
+
+/* Scaled buffers can't use the pre-rasterized glyphs and runs, they'd be
+ * resampled; the glyphs are rendered at the buffer's resolution instead */
+static void swbuf_text_scaled_draw(struct cairo_swbuf_t *surface, const struct swbuf_widget_t *widget) {
+	const struct font_placement_t *placement = &widget->placement.font;
+	struct swbuf_font_t font;
+	if (!swbuf_font_acquire(surface, placement, &font)) {
+		return;
+	}
+	cairo_set_scaled_font(surface->ctx, font.scaled_font);
 	swbuf_set_source_rgb(surface, placement->font_color);
-	cairo_move_to(surface->ctx, abs_placement.top_left.x - extents.x_bearing, abs_placement.bottom_right.y);
-	cairo_show_text(surface->ctx, text);
+	cairo_move_to(surface->ctx, widget->origin_x, widget->origin_y);
+	cairo_show_text(surface->ctx, widget->text);
+	swbuf_font_release(&font);
+}
+
+static void swbuf_text_draw(struct cairo_swbuf_t *surface, const struct swbuf_widget_t *widget) {
+	const struct glyph_atlas_t *atlas = NULL;
+	if (surface->scale != 1) {
+		swbuf_text_scaled_draw(surface, widget);
+	} else if (glyph_atlas_can_render(widget->text)) {
+		/* Numbers change all the time, compose them from single glyphs
+		 * instead of caching every value as its own run */
+		atlas = glyph_atlas_get(surface, &widget->placement.font);
+	}
+	if (atlas) {
+		glyph_atlas_draw(surface, atlas, widget->text, widget->origin_x, widget->origin_y);
+	} else if (surface->scale == 1) {
+		swbuf_text_run_draw(surface, widget);
+	}
 
 #if CAIRO_DEBUG
-	swbuf_circle(surface, abs_placement.anchor.x, abs_placement.anchor.y, 4, COLOR_RED);
-	swbuf_circle(surface, abs_placement.top_left.x, abs_placement.bottom_right.y, 2, COLOR_GREEN);
+	const struct placement_t *abs_placement = &widget->debug_placement;
+	swbuf_circle(surface, abs_placement->anchor.x, abs_placement->anchor.y, 4, COLOR_RED);
+	swbuf_circle(surface, abs_placement->top_left.x, abs_placement->bottom_right.y, 2, COLOR_GREEN);
 	swbuf_rect(surface, &(const struct rect_placement_t) {
 		.placement = {
-			.xoffset = abs_placement.top_left.x,
-			.yoffset = abs_placement.top_left.y,
+			.xoffset = abs_placement->top_left.x,
+			.yoffset = abs_placement->top_left.y,
 		},
-		.width = extents.width,
-		.height = font_extents.ascent,
+		.width = abs_placement->bottom_right.x - abs_placement->top_left.x,
+		.height = abs_placement->bottom_right.y - abs_placement->top_left.y,
 		.color = COLOR_GREEN,
 	});
 #endif
-	return assumed_width;
 }
 
-void swbuf_rect(struct cairo_swbuf_t *surface, const struct rect_placement_t *placement) {
+static void swbuf_rect_measure(struct cairo_swbuf_t *surface, struct swbuf_widget_t *widget) {
+	const struct rect_placement_t *placement = &widget->placement.rect;
 	struct placement_t abs_placement = swbuf_calculate_placement(surface, &placement->placement, placement->width, placement->height);
+	widget->origin_x = abs_placement.top_left.x;
+	widget->origin_y = abs_placement.top_left.y;
+
+	/* Stroked outlines reach half a line width beyond the rectangle */
+	widget->extents = abs_placement;
+	widget->extents.top_left.x -= 1;
+	widget->extents.top_left.y -= 1;
+	widget->extents.bottom_right.x += 1;
+	widget->extents.bottom_right.y += 1;
+}
+
+static void swbuf_rect_draw(struct cairo_swbuf_t *surface, const struct swbuf_widget_t *widget) {
+	const struct rect_placement_t *placement = &widget->placement.rect;
+	const struct placement_t abs_placement = {
+		.top_left = {
+			.x = widget->origin_x,
+			.y = widget->origin_y,
+		},
+		.bottom_right = {
+			.x = widget->origin_x + placement->width,
+			.y = widget->origin_y + placement->height,
+		},
+	};
 
 	if (placement->round == 0) {
 		cairo_rectangle(surface->ctx, abs_placement.top_left.x, abs_placement.top_left.y, placement->width, placement->height);
@@ -302,6 +931,423 @@ void swbuf_rect(struct cairo_swbuf_t *surface, const struct rect_placement_t *pl
 	}
 }
 
+static void swbuf_widget_measure(struct cairo_swbuf_t *surface, struct swbuf_widget_t *widget) {
+	switch (widget->type) {
+		case WIDGET_TEXT:
+			swbuf_text_measure(surface, widget);
+			break;
+
+		case WIDGET_RECT:
+			swbuf_rect_measure(surface, widget);
+			break;
+	}
+}
+
+static void swbuf_widget_draw(struct cairo_swbuf_t *surface, const struct swbuf_widget_t *widget) {
+	switch (widget->type) {
+		case WIDGET_TEXT:
+			swbuf_text_draw(surface, widget);
+			break;
+
+		case WIDGET_RECT:
+			swbuf_rect_draw(surface, widget);
+			break;
+	}
+}
+
+/* While a frame is being recorded, widgets are only measured. If they were
+ * drawn with identical inputs in the previous frame, not even that is
+ * necessary. Outside of frames, widgets are drawn immediately. */
+static void swbuf_widget_submit(struct cairo_swbuf_t *surface, struct swbuf_widget_t *widget) {
+	if (surface->tracking.recording) {
+		const struct swbuf_widget_t *previous = swbuf_unchanged_widget(surface, widget);
+		if (previous) {
+			*widget = *previous;
+		} else {
+			swbuf_widget_measure(surface, widget);
+		}
+	} else {
+		swbuf_widget_measure(surface, widget);
+		swbuf_widget_draw(surface, widget);
+	}
+}
+
+static struct swbuf_widget_t *swbuf_widget_alloc(struct cairo_swbuf_t *surface, struct swbuf_widget_t *local_widget) {
+	if (!surface->tracking.recording) {
+		return local_widget;
+	}
+	struct swbuf_widget_t *widget = swbuf_widget_list_append(&surface->tracking.current);
+	if (!widget) {
+		/* We lost track of what is on screen */
+		surface->tracking.full_redraw = true;
+	}
+	return widget;
+}
+
+void swbuf_set_damage_tracking(struct cairo_swbuf_t *surface, bool enabled) {
+	surface->tracking.enabled = enabled;
+	surface->tracking.full_redraw = true;
+}
+
+void swbuf_invalidate(struct cairo_swbuf_t *surface) {
+	surface->tracking.full_redraw = true;
+}
+
+static void swbuf_free_bands(struct cairo_swbuf_t *surface) {
+	struct swbuf_tiling_t *tiling = &surface->tiling;
+	for (unsigned int i = 0; i < tiling->band_count; i++) {
+		cairo_destroy(tiling->bands[i].ctx);
+		cairo_surface_destroy(tiling->bands[i].surface);
+	}
+	free(tiling->bands);
+	tiling->bands = NULL;
+	tiling->band_count = 0;
+	tiling->workers = NULL;
+}
+
+/* Splits the surface into the given number of horizontal bands which are then
+ * repainted in parallel by the workers. Only applies to the replay of
+ * recorded widgets at the end of a frame, i.e., needs damage tracking. A band
+ * count of one (or no workers) turns tiling off again. */
+bool swbuf_set_tiling(struct cairo_swbuf_t *surface, struct workpool_t *workers, unsigned int band_count) {
+	swbuf_free_bands(surface);
+	if (!workers || (band_count < 2)) {
+		return true;
+	}
+	if (band_count > surface->pixel_height) {
+		band_count = surface->pixel_height;
+	}
+
+	struct swbuf_tiling_t *tiling = &surface->tiling;
+	tiling->bands = calloc(sizeof(struct swbuf_band_t), band_count);
+	if (!tiling->bands) {
+		perror("calloc");
+		return false;
+	}
+	tiling->workers = workers;
+
+	cairo_surface_flush(surface->surface);
+	unsigned char *data = cairo_image_surface_get_data(surface->surface);
+	const int stride = cairo_image_surface_get_stride(surface->surface);
+	const unsigned int band_height = (surface->pixel_height + band_count - 1) / band_count;
+	for (unsigned int i = 0; i < band_count; i++) {
+		const unsigned int y = i * band_height;
+		if (y >= surface->pixel_height) {
+			break;
+		}
+		const unsigned int height = ((y + band_height) > surface->pixel_height) ? (surface->pixel_height - y) : band_height;
+		struct swbuf_band_t *band = &tiling->bands[i];
+		band->surface = cairo_image_surface_create_for_data(data + (y * stride), surface->format, surface->pixel_width, height, stride);
+		if (surface->scale != 1) {
+			cairo_surface_set_device_scale(band->surface, surface->scale, surface->scale);
+		}
+		band->ctx = cairo_create(band->surface);
+		tiling->band_count++;
+		if (cairo_status(band->ctx) != CAIRO_STATUS_SUCCESS) {
+			fprintf(stderr, "Could not create render band %u, disabling tiled rendering.\n", i);
+			swbuf_free_bands(surface);
+			return false;
+		}
+
+		/* Widgets are placed in surface coordinates */
+		cairo_translate(band->ctx, 0, -(double)y / surface->scale);
+		band->bounds = (struct placement_t) {
+			.top_left = { .x = 0, .y = floor(y / surface->scale) },
+			.bottom_right = { .x = surface->width, .y = ceil((y + height) / surface->scale) },
+		};
+	}
+	return true;
+}
+
+void swbuf_begin_frame(struct cairo_swbuf_t *surface, uint32_t bgcolor) {
+	struct swbuf_tracking_t *tracking = &surface->tracking;
+	struct swbuf_layer_t *layer = &surface->static_layer;
+	tracking->damage.rect_count = 0;
+	layer->previously_used = layer->used;
+	layer->used = false;
+	layer->rebuilt = false;
+	if (bgcolor != tracking->bgcolor) {
+		/* The static layer is painted on top of the background color */
+		tracking->bgcolor = bgcolor;
+		tracking->full_redraw = true;
+		layer->valid = false;
+	}
+
+	if (!tracking->enabled) {
+		/* Every frame is painted from scratch */
+		swbuf_clear(surface, bgcolor);
+		swbuf_damage_add_all(surface, &tracking->damage);
+		return;
+	}
+
+	tracking->current.count = 0;
+	tracking->recording = true;
+}
+
+static void swbuf_paint_background(struct cairo_swbuf_t *surface) {
+	if (surface->static_layer.used) {
+		cairo_set_source_surface(surface->ctx, surface->static_layer.surface, 0, 0);
+	} else {
+		swbuf_set_source_rgb(surface, surface->tracking.bgcolor);
+	}
+	cairo_paint(surface->ctx);
+}
+
+bool swbuf_begin_static_layer(struct cairo_swbuf_t *surface, uint32_t layer_key) {
+	struct swbuf_layer_t *layer = &surface->static_layer;
+	if (layer->valid && (layer->key == layer_key)) {
+		layer->used = true;
+		if (!surface->tracking.recording) {
+			swbuf_paint_background(surface);
+		}
+		return false;
+	}
+
+	if (layer->unavailable) {
+		return true;
+	}
+
+	if (!layer->surface) {
+		layer->surface = cairo_image_surface_create(surface->format, surface->pixel_width, surface->pixel_height);
+		if (cairo_surface_status(layer->surface) != CAIRO_STATUS_SUCCESS) {
+			/* Static content is then simply drawn like everything else */
+			fprintf(stderr, "Could not create static layer, drawing static content per frame.\n");
+			cairo_surface_destroy(layer->surface);
+			layer->surface = NULL;
+			layer->unavailable = true;
+			return true;
+		}
+		if (surface->scale != 1) {
+			cairo_surface_set_device_scale(layer->surface, surface->scale, surface->scale);
+		}
+		layer->ctx = cairo_create(layer->surface);
+	}
+
+	/* Redirect all drawing into the layer until swbuf_end_static_layer() */
+	layer->used = true;
+	layer->valid = false;
+	layer->key = layer_key;
+	layer->drawing = true;
+	layer->saved_ctx = surface->ctx;
+	layer->saved_recording = surface->tracking.recording;
+	surface->ctx = layer->ctx;
+	surface->tracking.recording = false;
+	swbuf_set_source_rgb(surface, surface->tracking.bgcolor);
+	cairo_paint(surface->ctx);
+	return true;
+}
+
+void swbuf_end_static_layer(struct cairo_swbuf_t *surface) {
+	struct swbuf_layer_t *layer = &surface->static_layer;
+	if (!layer->drawing) {
+		return;
+	}
+	surface->ctx = layer->saved_ctx;
+	surface->tracking.recording = layer->saved_recording;
+	layer->saved_ctx = NULL;
+	layer->drawing = false;
+	layer->valid = true;
+	layer->rebuilt = true;
+	cairo_surface_flush(layer->surface);
+	if (!surface->tracking.recording) {
+		swbuf_paint_background(surface);
+	}
+}
+
+/* On scaled buffers, clip edges would otherwise fall between pixels and blend
+ * the repainted content with what was there before */
+static void swbuf_pixel_aligned_rectangle(struct cairo_swbuf_t *surface, const struct placement_t *rect) {
+	const double scale = surface->scale;
+	const double x0 = floor(rect->top_left.x * scale) / scale;
+	const double y0 = floor(rect->top_left.y * scale) / scale;
+	const double x1 = ceil(rect->bottom_right.x * scale) / scale;
+	const double y1 = ceil(rect->bottom_right.y * scale) / scale;
+	cairo_rectangle(surface->ctx, x0, y0, x1 - x0, y1 - y0);
+}
+
+/* Repaints the damaged area, limited to the given bounds if there are any */
+static void swbuf_repaint_clipped(struct cairo_swbuf_t *surface, const struct placement_t *bounds) {
+	const struct swbuf_tracking_t *tracking = &surface->tracking;
+	const struct swbuf_damage_t *damage = &tracking->damage;
+
+	cairo_save(surface->ctx);
+	cairo_new_path(surface->ctx);
+	for (unsigned int i = 0; i < damage->rect_count; i++) {
+		swbuf_pixel_aligned_rectangle(surface, &damage->rects[i]);
+	}
+	cairo_clip(surface->ctx);
+	if (bounds) {
+		swbuf_pixel_aligned_rectangle(surface, bounds);
+		cairo_clip(surface->ctx);
+	}
+	swbuf_paint_background(surface);
+
+	/* Unchanged widgets that overlap the damage need to be redrawn as well,
+	 * we've just painted over them */
+	for (unsigned int i = 0; i < tracking->current.count; i++) {
+		const struct swbuf_widget_t *widget = &tracking->current.widgets[i];
+		if (bounds && !placement_overlaps(bounds, &widget->extents)) {
+			continue;
+		}
+		if (swbuf_damage_intersects(damage, &widget->extents)) {
+			swbuf_widget_draw(surface, widget);
+		}
+	}
+	cairo_restore(surface->ctx);
+}
+
+static void swbuf_repaint_band(void *vsurface, unsigned int band_index) {
+	const struct cairo_swbuf_t *surface = (const struct cairo_swbuf_t*)vsurface;
+	const struct swbuf_band_t *band = &surface->tiling.bands[band_index];
+	if (!swbuf_damage_intersects(&surface->tracking.damage, &band->bounds)) {
+		return;
+	}
+
+	/* Same surface, but everything is drawn through the band's context */
+	struct cairo_swbuf_t band_view = *surface;
+	band_view.ctx = band->ctx;
+	swbuf_repaint_clipped(&band_view, &band->bounds);
+	cairo_surface_flush(band->surface);
+}
+
+static void swbuf_repaint_damage(struct cairo_swbuf_t *surface) {
+	if (surface->tiling.band_count < 2) {
+		swbuf_repaint_clipped(surface, NULL);
+		return;
+	}
+
+	/* The bands write to the pixel memory behind cairo's back */
+	cairo_surface_flush(surface->surface);
+	workpool_run(surface->tiling.workers, swbuf_repaint_band, surface, surface->tiling.band_count);
+	cairo_surface_mark_dirty(surface->surface);
+}
+
+const struct swbuf_damage_t *swbuf_end_frame(struct cairo_swbuf_t *surface) {
+	struct swbuf_tracking_t *tracking = &surface->tracking;
+	if (!tracking->recording) {
+		return &tracking->damage;
+	}
+	tracking->recording = false;
+
+	const struct swbuf_layer_t *layer = &surface->static_layer;
+	if (layer->rebuilt || (layer->used != layer->previously_used)) {
+		/* The background underneath every widget has changed */
+		tracking->full_redraw = true;
+	}
+
+	if (tracking->full_redraw) {
+		tracking->full_redraw = false;
+		swbuf_damage_add_all(surface, &tracking->damage);
+	} else {
+		swbuf_damage_diff(surface, &tracking->damage, &tracking->drawn, &tracking->current);
+	}
+
+	if (tracking->damage.rect_count) {
+		swbuf_repaint_damage(surface);
+	}
+
+	/* What was just recorded now is what is on the surface */
+	struct swbuf_widget_list_t drawn = tracking->drawn;
+	tracking->drawn = tracking->current;
+	tracking->current = drawn;
+	tracking->current.count = 0;
+	return &tracking->damage;
+}
+
+bool swbuf_has_damage(const struct cairo_swbuf_t *surface) {
+	return surface->tracking.damage.rect_count > 0;
+}
+
+/* Determines where the contents of two surfaces that both completed a frame
+ * differ, i.e., what needs to be copied out when a display that currently
+ * shows "previous" is switched to "surface". Without a previous surface,
+ * everything is damaged. */
+void swbuf_get_damage_since(const struct cairo_swbuf_t *surface, const struct cairo_swbuf_t *previous, struct swbuf_damage_t *damage) {
+	damage->rect_count = 0;
+	if (surface == previous) {
+		return;
+	}
+
+	bool full_damage = !previous || !surface->tracking.enabled || !previous->tracking.enabled;
+	if (!full_damage) {
+		const struct swbuf_layer_t *layer = &surface->static_layer;
+		const struct swbuf_layer_t *previous_layer = &previous->static_layer;
+		full_damage = (surface->width != previous->width) || (surface->height != previous->height) || (surface->scale != previous->scale);
+		full_damage = full_damage || (surface->tracking.bgcolor != previous->tracking.bgcolor);
+		full_damage = full_damage || (layer->used != previous_layer->used) || (layer->used && (layer->key != previous_layer->key));
+	}
+
+	if (full_damage) {
+		swbuf_damage_add_all(surface, damage);
+	} else {
+		swbuf_damage_diff(surface, damage, &previous->tracking.drawn, &surface->tracking.drawn);
+	}
+}
+
+void swbuf_render_table(struct cairo_swbuf_t *surface, const struct table_definition_t *table, void *ctx) {
+	const unsigned int table_height = table->row_height * table->rows;
+	unsigned int table_width = 0;
+	for (unsigned int x = 0; x < table->columns; x++) {
+		table_width += table->column_widths[x];
+	}
+	struct placement_t table_placement = swbuf_calculate_placement(surface, &table->anchor, table_width, table_height);
+
+	unsigned int base_x = 0;
+	for (unsigned int x = 0; x < table->columns; x++) {
+		for (unsigned int y = table->first_row; y < table->rows; y++) {
+			unsigned int base_y = table->row_height * y;
+			struct font_placement_t placement = table->font_default;
+			placement.placement.xoffset = table_placement.top_left.x + base_x;
+			placement.placement.yoffset = table_placement.top_left.y + base_y;
+
+			char buffer[256];
+			buffer[0] = 0;
+			table->rendering_callback(buffer, sizeof(buffer), &placement, x, y, ctx);
+			swbuf_text(surface, &placement, "%s", buffer);
+		}
+		base_x += table->column_widths[x];
+	}
+}
+
+unsigned int swbuf_text(struct cairo_swbuf_t *surface, const struct font_placement_t *placement, const char *fmt, ...) {
+	struct swbuf_widget_t local_widget;
+	struct swbuf_widget_t *widget = swbuf_widget_alloc(surface, &local_widget);
+	if (!widget) {
+		return 0;
+	}
+
+	widget->type = WIDGET_TEXT;
+	widget->placement.font = *placement;
+	va_list ap;
+	va_start(ap, fmt);
+	vsnprintf(widget->text, sizeof(widget->text), fmt, ap);
+	va_end(ap);
+
+	if (!placement->font_size) {
+		fprintf(stderr, "Warning: Font size zero. Not rendered: \"%s\"\n", widget->text);
+		if (widget != &local_widget) {
+			surface->tracking.current.count--;
+		}
+		return 0;
+	}
+
+	swbuf_widget_submit(surface, widget);
+	return widget->text_width;
+}
+
+void swbuf_rect(struct cairo_swbuf_t *surface, const struct rect_placement_t *placement) {
+	struct swbuf_widget_t local_widget;
+	struct swbuf_widget_t *widget = swbuf_widget_alloc(surface, &local_widget);
+	if (!widget) {
+		return;
+	}
+
+	widget->type = WIDGET_RECT;
+	widget->placement.rect = *placement;
+	widget->text[0] = 0;
+	swbuf_widget_submit(surface, widget);
+}
+
 void swbuf_circle(struct cairo_swbuf_t *surface, unsigned int x, unsigned int y, unsigned int radius, uint32_t color) {
 	swbuf_set_source_rgb(surface, color);
 	cairo_move_to(surface->ctx, x + radius, y);
@@ -317,8 +1363,15 @@ void free_swbuf(struct cairo_swbuf_t *buffer) {
 	if (!buffer) {
 		return;
 	}
+	swbuf_free_bands(buffer);
 	cairo_destroy(buffer->ctx);
 	cairo_surface_destroy(buffer->surface);
+	if (buffer->static_layer.surface) {
+		cairo_destroy(buffer->static_layer.ctx);
+		cairo_surface_destroy(buffer->static_layer.surface);
+	}
+	free(buffer->tracking.drawn.widgets);
+	free(buffer->tracking.current.widgets);
 	free(buffer);
 }
 
@@ -331,6 +1384,20 @@ void cairo_cleanup(void) {
 	 * to tell fontconfig to get its shit together even though it's Cairo's (!!)
 	 * transitive dependency. What a bunch of garbage.
 	 */
+	pthread_mutex_lock(&font_cache.mutex);
+	for (unsigned int i = 0; i < font_cache.entry_count; i++) {
+		cairo_scaled_font_destroy(font_cache.entries[i].scaled_font);
+	}
+	font_cache.entry_count = 0;
+	font_cache.next_eviction = 0;
+	pthread_mutex_unlock(&font_cache.mutex);
+	textcache_clear(&text_cache);
+	pthread_mutex_lock(&glyph_atlases.mutex);
+	for (unsigned int i = 0; i < glyph_atlases.atlas_count; i++) {
+		cairo_surface_destroy(glyph_atlases.atlases[i].surface);
+	}
+	glyph_atlases.atlas_count = 0;
+	pthread_mutex_unlock(&glyph_atlases.mutex);
 	cairo_debug_reset_static_data();
 	FcFini();
 }
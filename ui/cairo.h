@@ -25,14 +25,10 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <cairo/cairo.h>
 #include "colors.h"
-
-struct cairo_swbuf_t {
-	cairo_surface_t *surface;
-	cairo_t *ctx;
-	unsigned int width, height;
-};
+#include "workpool.h"
 
 enum xanchor_t {
 	XPOS_LEFT,
@@ -76,6 +72,11 @@ struct rect_placement_t {
 	bool fill;
 };
 
+struct font_cache_stats_t {
+	unsigned long lookups;
+	unsigned long hits;
+};
+
 struct coordinate_t {
 	int x, y;
 };
@@ -88,8 +89,96 @@ struct placement_t {
 #endif
 };
 
+#define SWBUF_MAX_TEXT_LENGTH			512
+#define SWBUF_MAX_DAMAGE_RECTS			16
+
+enum swbuf_widget_type_t {
+	WIDGET_TEXT,
+	WIDGET_RECT,
+};
+
+/* A widget is a single recorded draw call together with all inputs it was
+ * drawn with and the bounding box it covers on the surface */
+struct swbuf_widget_t {
+	enum swbuf_widget_type_t type;
+	union {
+		struct font_placement_t font;
+		struct rect_placement_t rect;
+	} placement;
+	char text[SWBUF_MAX_TEXT_LENGTH];
+	unsigned int text_width;
+	double origin_x, origin_y;
+	struct placement_t extents;
+#if CAIRO_DEBUG
+	struct placement_t debug_placement;
+#endif
+};
+
+struct swbuf_widget_list_t {
+	unsigned int count, capacity;
+	struct swbuf_widget_t *widgets;
+};
+
+struct swbuf_damage_t {
+	unsigned int rect_count;
+	struct placement_t rects[SWBUF_MAX_DAMAGE_RECTS];
+};
+
+struct swbuf_tracking_t {
+	bool enabled;
+	bool recording;
+	bool full_redraw;
+	uint32_t bgcolor;
+	struct swbuf_widget_list_t drawn, current;
+	struct swbuf_damage_t damage;
+};
+
+/* Pre-rasterized content that is composited underneath all widgets. It is
+ * identified by a caller-chosen key and only redrawn when that key changes. */
+struct swbuf_layer_t {
+	cairo_surface_t *surface;
+	cairo_t *ctx;
+	cairo_t *saved_ctx;
+	uint32_t key;
+	bool valid;
+	bool unavailable;
+	bool drawing;
+	bool saved_recording;
+	bool used, previously_used;
+	bool rebuilt;
+};
+
+/* Horizontal band of the surface that shares the surface's pixel memory, so
+ * that bands can be repainted from different threads */
+struct swbuf_band_t {
+	cairo_surface_t *surface;
+	cairo_t *ctx;
+	struct placement_t bounds;
+};
+
+struct swbuf_tiling_t {
+	struct workpool_t *workers;
+	unsigned int band_count;
+	struct swbuf_band_t *bands;
+};
+
+struct cairo_swbuf_t {
+	cairo_surface_t *surface;
+	cairo_t *ctx;
+	cairo_format_t format;
+	/* Layout happens in width x height, which the pixel buffer holds at the
+	 * given scale */
+	unsigned int width, height;
+	double scale;
+	unsigned int pixel_width, pixel_height;
+	struct swbuf_tracking_t tracking;
+	struct swbuf_layer_t static_layer;
+	struct swbuf_tiling_t tiling;
+};
+
 struct table_definition_t {
 	unsigned int columns, rows;
+	unsigned int first_row;
 	unsigned int *column_widths;
 	unsigned int row_height;
 	struct anchored_placement_t anchor;
@@ -99,9 +188,26 @@ struct table_definition_t {
 
 /*************** AUTO GENERATED SECTION FOLLOWS ***************/
 struct cairo_swbuf_t *create_swbuf(unsigned int width, unsigned int height);
+struct cairo_swbuf_t *create_swbuf_for_bpp(unsigned int width, unsigned int height, unsigned int bits_per_pixel);
+struct cairo_swbuf_t *create_swbuf_scaled(unsigned int width, unsigned int height, unsigned int bits_per_pixel, double scale);
+struct cairo_swbuf_t *create_swbuf_for_data(uint8_t *data, unsigned int width, unsigned int height, unsigned int stride, unsigned int bits_per_pixel);
 void swbuf_clear(struct cairo_swbuf_t *surface, uint32_t bgcolor);
-uint32_t* swbuf_get_pixel_data(const struct cairo_swbuf_t *surface);
+uint8_t* swbuf_get_pixel_data(const struct cairo_swbuf_t *surface);
+unsigned int swbuf_get_stride(const struct cairo_swbuf_t *surface);
+unsigned int swbuf_get_bits_per_pixel(const struct cairo_swbuf_t *surface);
 uint32_t swbuf_get_pixel(const struct cairo_swbuf_t *surface, unsigned int x, unsigned int y);
+void swbuf_get_font_cache_stats(struct font_cache_stats_t *stats);
+void swbuf_set_text_cache_limit(size_t memory_limit);
+void swbuf_print_cache_stats(void);
+void swbuf_set_damage_tracking(struct cairo_swbuf_t *surface, bool enabled);
+void swbuf_invalidate(struct cairo_swbuf_t *surface);
+bool swbuf_set_tiling(struct cairo_swbuf_t *surface, struct workpool_t *workers, unsigned int band_count);
+void swbuf_begin_frame(struct cairo_swbuf_t *surface, uint32_t bgcolor);
+bool swbuf_begin_static_layer(struct cairo_swbuf_t *surface, uint32_t layer_key);
+void swbuf_end_static_layer(struct cairo_swbuf_t *surface);
+const struct swbuf_damage_t *swbuf_end_frame(struct cairo_swbuf_t *surface);
+bool swbuf_has_damage(const struct cairo_swbuf_t *surface);
+void swbuf_get_damage_since(const struct cairo_swbuf_t *surface, const struct cairo_swbuf_t *previous, struct swbuf_damage_t *damage);
 void swbuf_render_table(struct cairo_swbuf_t *surface, const struct table_definition_t *table, void *ctx);
 unsigned int swbuf_text(struct cairo_swbuf_t *surface, const struct font_placement_t *placement, const char *fmt, ...);
 void swbuf_rect(struct cairo_swbuf_t *surface, const struct rect_placement_t *placement);
@@ -21,19 +21,98 @@
 */
 
 #include "cairoglue.h"
+#include "pixelops.h"
 
-void blit_swbuf_on_display(struct cairo_swbuf_t *swbuf, struct display_t *target) {
-	/* Try to fast blit first */
-	if ((target->calltable->blit_buffer) && target->calltable->blit_buffer(target, swbuf_get_pixel_data(swbuf), swbuf->width, swbuf->height)) {
+/* Reads back 24 bit RGB from either of the two image formats */
+static uint32_t display_image_get_pixel(const struct display_image_t *image, unsigned int x, unsigned int y) {
+	const uint8_t *row = image->pixels + (y * image->stride);
+	if (image->bits_per_pixel == 16) {
+		const uint16_t pixel = ((const uint16_t*)row)[x];
+		const uint8_t r = (pixel >> 11) & 0x1f;
+		const uint8_t g = (pixel >> 5) & 0x3f;
+		const uint8_t b = (pixel >> 0) & 0x1f;
+		return MK_RGB((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+	}
+	return ((const uint32_t*)row)[x] & 0xffffff;
+}
+
+void swbuf_get_display_image(const struct cairo_swbuf_t *swbuf, struct display_image_t *image) {
+	*image = (struct display_image_t) {
+		.pixels = swbuf_get_pixel_data(swbuf),
+		.width = swbuf->pixel_width,
+		.height = swbuf->pixel_height,
+		.stride = swbuf_get_stride(swbuf),
+		.bits_per_pixel = swbuf_get_bits_per_pixel(swbuf),
+	};
+}
+
+/* Damage is in layout coordinates, which are display coordinates. Each
+ * rectangle is grown by the margin, clipped to the display. */
+unsigned int swbuf_damage_to_display_rects(const struct swbuf_damage_t *damage, unsigned int margin, const struct display_t *display, struct display_rect_t *rects) {
+	for (unsigned int i = 0; i < damage->rect_count; i++) {
+		const struct placement_t *rect = &damage->rects[i];
+		const int x0 = ((rect->top_left.x - (int)margin) < 0) ? 0 : (rect->top_left.x - (int)margin);
+		const int y0 = ((rect->top_left.y - (int)margin) < 0) ? 0 : (rect->top_left.y - (int)margin);
+		const int x1 = ((rect->bottom_right.x + margin) > display->width) ? (int)display->width : (rect->bottom_right.x + (int)margin);
+		const int y1 = ((rect->bottom_right.y + margin) > display->height) ? (int)display->height : (rect->bottom_right.y + (int)margin);
+		rects[i] = (struct display_rect_t) {
+			.x = x0,
+			.y = y0,
+			.width = (x1 > x0) ? (x1 - x0) : 0,
+			.height = (y1 > y0) ? (y1 - y0) : 0,
+		};
+	}
+	return damage->rect_count;
+}
+
+/* Brings the given rectangles of a scaled swbuf to display resolution; dest
+ * is display sized and in the swbuf's pixel format */
+void swbuf_upscale_rects(const struct cairo_swbuf_t *swbuf, const struct display_rect_t *rects, unsigned int rect_count, uint8_t *dest, unsigned int dest_stride, bool bilinear) {
+	struct display_image_t source;
+	swbuf_get_display_image(swbuf, &source);
+	for (unsigned int i = 0; i < rect_count; i++) {
+		const struct display_rect_t *rect = &rects[i];
+		pixelops_scale_rect(pixelops_get(), dest, dest_stride, rect->x, rect->y, rect->width, rect->height, source.pixels, source.stride, source.width, source.height, source.bits_per_pixel, 1 / swbuf->scale, bilinear);
+	}
+}
+
+/* The rectangles need to describe how the image differs from what the display
+ * currently shows */
+void blit_image_rects_on_display(const struct display_image_t *image, const struct display_rect_t *rects, unsigned int rect_count, struct display_t *target) {
+	/* Only copy what has changed if the display supports it */
+	if (target->calltable->blit_rects && (image->width == target->width) && (image->height == target->height)) {
+		if (target->calltable->blit_rects(target, image, rects, rect_count)) {
+			return;
+		}
+	}
+
+	/* Then try to fast blit the whole frame */
+	if ((target->calltable->blit_buffer) && target->calltable->blit_buffer(target, image)) {
 		/* Success! */
 		return;
 	}
 
-	/* Else fallback to slow per-pixel copies */
-	for (int y = 0; y < swbuf->height; y++) {
-		for (int x = 0; x < swbuf->width; x++) {
-			uint32_t rgb = swbuf_get_pixel(swbuf, x, y);
-			display_put_pixel(target, x, y, rgb);
+	/* Else fallback to slow per-pixel copies, but only of what has changed */
+	for (unsigned int i = 0; i < rect_count; i++) {
+		const struct display_rect_t *rect = &rects[i];
+		for (unsigned int y = rect->y; y < rect->y + rect->height; y++) {
+			for (unsigned int x = rect->x; x < rect->x + rect->width; x++) {
+				display_put_pixel(target, x, y, display_image_get_pixel(image, x, y));
+			}
 		}
 	}
 }
+
+/* The damage needs to describe how the buffer differs from what the display
+ * currently shows */
+void blit_swbuf_damage_on_display(struct cairo_swbuf_t *swbuf, const struct swbuf_damage_t *damage, struct display_t *target) {
+	struct display_image_t image;
+	swbuf_get_display_image(swbuf, &image);
+	struct display_rect_t rects[SWBUF_MAX_DAMAGE_RECTS];
+	const unsigned int rect_count = swbuf_damage_to_display_rects(damage, 0, target, rects);
+	blit_image_rects_on_display(&image, rects, rect_count, target);
+}
+
+void blit_swbuf_on_display(struct cairo_swbuf_t *swbuf, struct display_t *target) {
+	blit_swbuf_damage_on_display(swbuf, &swbuf->tracking.damage, target);
+}
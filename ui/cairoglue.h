@@ -27,6 +27,11 @@
 #include "cairo.h"
 
 /*************** AUTO GENERATED SECTION FOLLOWS ***************/
+void swbuf_get_display_image(const struct cairo_swbuf_t *swbuf, struct display_image_t *image);
+unsigned int swbuf_damage_to_display_rects(const struct swbuf_damage_t *damage, unsigned int margin, const struct display_t *display, struct display_rect_t *rects);
+void swbuf_upscale_rects(const struct cairo_swbuf_t *swbuf, const struct display_rect_t *rects, unsigned int rect_count, uint8_t *dest, unsigned int dest_stride, bool bilinear);
+void blit_image_rects_on_display(const struct display_image_t *image, const struct display_rect_t *rects, unsigned int rect_count, struct display_t *target);
+void blit_swbuf_damage_on_display(struct cairo_swbuf_t *swbuf, const struct swbuf_damage_t *damage, struct display_t *target);
 void blit_swbuf_on_display(struct cairo_swbuf_t *swbuf, struct display_t *target);
 /***************  AUTO GENERATED SECTION ENDS   ***************/
 
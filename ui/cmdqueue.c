@@ -0,0 +1,253 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cmdqueue.h"
+
+struct cmdqueue_t *cmdqueue_init(unsigned int capacity) {
+	struct cmdqueue_t *queue = calloc(sizeof(struct cmdqueue_t), 1);
+	if (!queue) {
+		perror("calloc");
+		return NULL;
+	}
+	queue->entries = calloc(sizeof(struct cmdqueue_entry_t), capacity);
+	if (!queue->entries) {
+		perror("calloc");
+		free(queue);
+		return NULL;
+	}
+	queue->capacity = capacity;
+	return queue;
+}
+
+static struct cmdqueue_entry_t *cmdqueue_entry(struct cmdqueue_t *queue, unsigned int index) {
+	return &queue->entries[(queue->head + index) % queue->capacity];
+}
+
+/* Makes room for a newer message. The oldest message that is coalescable,
+ * i.e., can simply be asked for again, goes first, otherwise the oldest
+ * message of all. The head is never evicted, the sender might be in the
+ * middle of sending it. */
+static bool cmdqueue_evict(struct cmdqueue_t *queue) {
+	if (queue->count < 2) {
+		return false;
+	}
+	unsigned int victim = 1;
+	for (unsigned int i = 1; i < queue->count; i++) {
+		if (cmdqueue_entry(queue, i)->coalescable) {
+			victim = i;
+			break;
+		}
+	}
+	free(cmdqueue_entry(queue, victim)->message);
+	free(cmdqueue_entry(queue, victim)->key);
+	for (unsigned int i = victim; i < queue->count - 1; i++) {
+		*cmdqueue_entry(queue, i) = *cmdqueue_entry(queue, i + 1);
+	}
+	queue->count--;
+	queue->dropped++;
+	return true;
+}
+
+static bool cmdqueue_entry_matches(const struct cmdqueue_entry_t *entry, const char *message, size_t length, const char *key) {
+	if (key) {
+		return entry->key && !strcmp(entry->key, key);
+	}
+	return !entry->key && (entry->length == length) && !memcmp(entry->message, message, length);
+}
+
+/* Takes ownership of the message and the key, which may be NULL. A
+ * coalescable message is dropped if the very same message, or one with the
+ * same key, is already waiting to be sent. If the queue is full, an
+ * older message is discarded in favor of the new one, since after a long
+ * disconnect the most recent commands are the ones that matter. Returns false
+ * if the message was not queued. */
+bool cmdqueue_push(struct cmdqueue_t *queue, char *message, size_t length, char *key, unsigned int tag, bool coalescable) {
+	if (coalescable) {
+		for (unsigned int i = 0; i < queue->count; i++) {
+			const struct cmdqueue_entry_t *entry = cmdqueue_entry(queue, i);
+			if (entry->coalescable && cmdqueue_entry_matches(entry, message, length, key)) {
+				queue->coalesced++;
+				free(message);
+				free(key);
+				return false;
+			}
+		}
+	}
+
+	if ((queue->count == queue->capacity) && !cmdqueue_evict(queue)) {
+		queue->dropped++;
+		free(message);
+		free(key);
+		return false;
+	}
+
+	*cmdqueue_entry(queue, queue->count) = (struct cmdqueue_entry_t) {
+		.message = message,
+		.length = length,
+		.key = key,
+		.tag = tag,
+		.coalescable = coalescable,
+	};
+	queue->count++;
+	return true;
+}
+
+/* Returns the tag of a message with the given key that has not been sent
+ * completely yet, or zero if there is none */
+unsigned int cmdqueue_find(struct cmdqueue_t *queue, const char *key) {
+	for (unsigned int i = 0; i < queue->count; i++) {
+		const struct cmdqueue_entry_t *entry = cmdqueue_entry(queue, i);
+		if (entry->key && !strcmp(entry->key, key)) {
+			return entry->tag;
+		}
+	}
+	return 0;
+}
+
+/* Returns the part of the oldest message that has not been sent yet */
+bool cmdqueue_peek(struct cmdqueue_t *queue, const char **data, size_t *length) {
+	if (!queue->count) {
+		return false;
+	}
+	const struct cmdqueue_entry_t *entry = cmdqueue_entry(queue, 0);
+	*data = entry->message + queue->head_sent;
+	*length = entry->length - queue->head_sent;
+	return true;
+}
+
+/* Marks bytes returned by cmdqueue_peek() as sent. Returns the tag of the
+ * message if it has been sent completely by that, zero otherwise. */
+unsigned int cmdqueue_consume(struct cmdqueue_t *queue, size_t length) {
+	struct cmdqueue_entry_t *entry = cmdqueue_entry(queue, 0);
+	queue->head_sent += length;
+	if (queue->head_sent < entry->length) {
+		return 0;
+	}
+	const unsigned int tag = entry->tag;
+	free(entry->message);
+	free(entry->key);
+	queue->head = (queue->head + 1) % queue->capacity;
+	queue->count--;
+	queue->head_sent = 0;
+	return tag;
+}
+
+/* A partially sent message is sent again as a whole, e.g., over a new
+ * connection */
+void cmdqueue_rewind(struct cmdqueue_t *queue) {
+	queue->head_sent = 0;
+}
+
+void cmdqueue_free(struct cmdqueue_t *queue) {
+	if (!queue) {
+		return;
+	}
+	while (queue->count) {
+		free(cmdqueue_entry(queue, 0)->message);
+		free(cmdqueue_entry(queue, 0)->key);
+		queue->head = (queue->head + 1) % queue->capacity;
+		queue->count--;
+	}
+	free(queue->entries);
+	free(queue);
+}
+
+#ifdef TEST_CMDQUEUE
+
+// gcc -Wall -D_POSIX_C_SOURCE=200112L -D_XOPEN_SOURCE=500 -Wall -Wmissing-prototypes -Wstrict-prototypes -Werror=implicit-function-declaration -Werror=format -Wshadow -Wswitch -std=c11 -DTEST_CMDQUEUE cmdqueue.c -o cmdqueue -ggdb3 -fsanitize=address -fsanitize=undefined -fsanitize=leak -fno-omit-frame-pointer && ./cmdqueue
+
+static void push(struct cmdqueue_t *queue, const char *text, bool coalescable) {
+	bool queued = cmdqueue_push(queue, strdup(text), strlen(text), NULL, 0, coalescable);
+	printf("Push %-12s %s\n", text, queued ? "queued" : "not queued");
+}
+
+static void push_request(struct cmdqueue_t *queue, const char *text, const char *key, unsigned int tag) {
+	bool queued = cmdqueue_push(queue, strdup(text), strlen(text), strdup(key), tag, true);
+	printf("Push %-12s %s\n", text, queued ? "queued" : "not queued");
+}
+
+static void dump(struct cmdqueue_t *queue) {
+	printf("Queue (%u entries, %lu coalesced, %lu dropped):", queue->count, queue->coalesced, queue->dropped);
+	for (unsigned int i = 0; i < queue->count; i++) {
+		const struct cmdqueue_entry_t *entry = cmdqueue_entry(queue, i);
+		printf(" %.*s", (int)entry->length, entry->message);
+	}
+	printf("\n");
+}
+
+int main(void) {
+	struct cmdqueue_t *queue = cmdqueue_init(4);
+
+	/* Coalescing: only identical coalescable messages are merged */
+	push(queue, "set_player:a", false);
+	push(queue, "status", true);
+	push(queue, "status", true);
+	push(queue, "set_player:b", false);
+	push(queue, "playerinfo", true);
+	dump(queue);
+
+	/* Overflow: the oldest coalescable messages make room first */
+	push(queue, "set_player:c", false);
+	dump(queue);
+	push(queue, "set_player:d", false);
+	dump(queue);
+
+	/* Without any coalescable message left, the oldest after the head goes */
+	push(queue, "set_player:e", false);
+	dump(queue);
+
+	/* A partially sent head is sent again as a whole after rewinding and is
+	 * never evicted */
+	const char *data;
+	size_t length;
+	cmdqueue_peek(queue, &data, &length);
+	cmdqueue_consume(queue, 3);
+	cmdqueue_peek(queue, &data, &length);
+	printf("Partially sent, left: %.*s\n", (int)length, data);
+	push(queue, "set_player:f", false);
+	cmdqueue_rewind(queue);
+	cmdqueue_peek(queue, &data, &length);
+	printf("Rewound, left: %.*s\n", (int)length, data);
+	dump(queue);
+
+	while (cmdqueue_peek(queue, &data, &length)) {
+		printf("Send %.*s\n", (int)length, data);
+		cmdqueue_consume(queue, length);
+	}
+	dump(queue);
+
+	/* Requests differ by their ID, but are coalesced and found by key */
+	push_request(queue, "playerinfo:1", "playerinfo", 1);
+	push_request(queue, "playerinfo:2", "playerinfo", 2);
+	printf("Queued playerinfo request: %u\n", cmdqueue_find(queue, "playerinfo"));
+	while (cmdqueue_peek(queue, &data, &length)) {
+		printf("Send %.*s\n", (int)length, data);
+		printf("Sent tag %u\n", cmdqueue_consume(queue, length));
+	}
+	printf("Queued playerinfo request: %u\n", cmdqueue_find(queue, "playerinfo"));
+	cmdqueue_free(queue);
+	return 0;
+}
+#endif
@@ -0,0 +1,62 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#ifndef __CMDQUEUE_H__
+#define __CMDQUEUE_H__
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/* The key identifies what a message asks for if the message itself differs
+ * between otherwise identical requests, e.g., by a request ID; that ID is
+ * kept as the tag. */
+struct cmdqueue_entry_t {
+	char *message;
+	size_t length;
+	char *key;
+	unsigned int tag;
+	bool coalescable;
+};
+
+/* Outbound messages waiting to be sent, oldest first. Only the sender ever
+ * removes the oldest entry and eviction on overflow never touches it, so the
+ * message returned by cmdqueue_peek() stays valid while new ones are being
+ * pushed. Locking is up to the caller. */
+struct cmdqueue_t {
+	struct cmdqueue_entry_t *entries;
+	unsigned int capacity;
+	unsigned int head, count;
+	size_t head_sent;
+	unsigned long coalesced, dropped;
+};
+
+/*************** AUTO GENERATED SECTION FOLLOWS ***************/
+struct cmdqueue_t *cmdqueue_init(unsigned int capacity);
+bool cmdqueue_push(struct cmdqueue_t *queue, char *message, size_t length, char *key, unsigned int tag, bool coalescable);
+unsigned int cmdqueue_find(struct cmdqueue_t *queue, const char *key);
+bool cmdqueue_peek(struct cmdqueue_t *queue, const char **data, size_t *length);
+unsigned int cmdqueue_consume(struct cmdqueue_t *queue, size_t length);
+void cmdqueue_rewind(struct cmdqueue_t *queue);
+void cmdqueue_free(struct cmdqueue_t *queue);
+/***************  AUTO GENERATED SECTION ENDS   ***************/
+
+#endif
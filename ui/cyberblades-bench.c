@@ -0,0 +1,179 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cairo.h"
+#include "workpool.h"
+#include "tools.h"
+#include "jsondom.h"
+#include "cyberblades-ui.h"
+#include "uistate.h"
+#include "renderer_fullhd.h"
+
+#define BENCH_WIDTH				1920
+#define BENCH_HEIGHT			1080
+#define BENCH_DEFAULT_FRAMES	2000
+#define BENCH_WARMUP_FRAMES		10
+
+static const char *default_fixtures[] = {
+	"bench/main_idle.json",
+	"bench/main_highscores.json",
+	"bench/game_busy.json",
+};
+
+/* Fixtures contain historian messages exactly as they appear on the wire, one
+ * JSON message per line, and are applied in order */
+static bool bench_load_fixture(struct ui_state_t *state, const char *filename) {
+	FILE *f = fopen(filename, "r");
+	if (!f) {
+		perror(filename);
+		return false;
+	}
+
+	memset(state, 0, sizeof(*state));
+	state->ui_screen = MAIN_SCREEN;
+	state->historian_state = CONNECTED;
+
+	bool success = true;
+	char line_buffer[1024 * 16];
+	unsigned int line_no = 0;
+	while (fgets(line_buffer, sizeof(line_buffer), f)) {
+		line_no++;
+		if (line_buffer[0] == '\n') {
+			continue;
+		}
+		struct jsondom_t *json = jsondom_parse(line_buffer);
+		if (!json) {
+			fprintf(stderr, "%s:%u: could not parse message.\n", filename, line_no);
+			success = false;
+			break;
+		}
+		const char *msgtype = jsondom_get_dict_str(json, "msgtype");
+		if (msgtype && !strcmp(msgtype, "status")) {
+			ui_state_apply_status(state, json);
+		} else if (msgtype && !strcmp(msgtype, "playerinfo")) {
+			struct player_info_t player;
+			struct highscore_table_t highscores;
+			if (ui_state_parse_playerinfo(json, &player, &highscores)) {
+				ui_state_apply_playerinfo(state, &player, &highscores);
+			}
+		} else {
+			fprintf(stderr, "%s:%u: unsupported message type.\n", filename, line_no);
+		}
+		jsondom_free(json);
+	}
+	fclose(f);
+	return success;
+}
+
+static int compare_double(const void *va, const void *vb) {
+	const double a = *(const double*)va;
+	const double b = *(const double*)vb;
+	return (a < b) ? -1 : ((a > b) ? 1 : 0);
+}
+
+static double percentile(const double *sorted_values, unsigned int count, unsigned int percent) {
+	unsigned int index = (count * percent) / 100;
+	if (index >= count) {
+		index = count - 1;
+	}
+	return sorted_values[index];
+}
+
+static void bench_fixture(const char *filename, const struct ui_state_t *state, unsigned int worker_count, double *frame_times, unsigned int frames) {
+	struct cairo_swbuf_t *swbuf = create_swbuf(BENCH_WIDTH, BENCH_HEIGHT);
+	struct workpool_t *workers = workpool_init(worker_count);
+	if (!swbuf || !workers || !swbuf_set_tiling(swbuf, workers, worker_count)) {
+		fprintf(stderr, "Could not set up %u workers.\n", worker_count);
+		exit(EXIT_FAILURE);
+	}
+
+	struct renderer_fullhd_state_t renderer_state = { 0 };
+	for (unsigned int i = 0; i < BENCH_WARMUP_FRAMES; i++) {
+		swbuf_invalidate(swbuf);
+		swbuf_render_full_hd(state, swbuf, &renderer_state);
+	}
+
+	/* Every frame is invalidated and therefore fully repainted, otherwise
+	 * damage tracking would reduce all but the first frame to nothing */
+	double total_time = 0;
+	for (unsigned int i = 0; i < frames; i++) {
+		double t0 = now();
+		swbuf_invalidate(swbuf);
+		swbuf_render_full_hd(state, swbuf, &renderer_state);
+		frame_times[i] = 1000 * (now() - t0);
+		total_time += frame_times[i];
+	}
+	qsort(frame_times, frames, sizeof(double), compare_double);
+
+	const double mean = total_time / frames;
+	printf("%-32s %7u %9.3f %9.3f %9.3f %9.1f\n", filename, worker_count, mean, percentile(frame_times, frames, 50), percentile(frame_times, frames, 99), 1000 / mean);
+
+	free_swbuf(swbuf);
+	workpool_free(workers);
+}
+
+int main(int argc, char **argv) {
+	unsigned int frames = BENCH_DEFAULT_FRAMES;
+	if (argc >= 2) {
+		frames = atoi(argv[1]);
+	}
+	if (frames == 0) {
+		fprintf(stderr, "%s [frame count] [fixture.json ...]\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	const char **fixtures = default_fixtures;
+	unsigned int fixture_count = sizeof(default_fixtures) / sizeof(const char*);
+	if (argc >= 3) {
+		fixtures = (const char**)argv + 2;
+		fixture_count = argc - 2;
+	}
+
+	double *frame_times = calloc(sizeof(double), frames);
+	if (!frame_times) {
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+
+	cairo_addfont("../external/beon/beon-webfont.ttf");
+	cairo_addfont("../external/instruction/Instruction.ttf");
+
+	printf("%u frames of %ux%u per run, times in milliseconds\n", frames, BENCH_WIDTH, BENCH_HEIGHT);
+	printf("%-32s %7s %9s %9s %9s %9s\n", "Fixture", "Workers", "Mean", "p50", "p99", "FPS");
+	const unsigned int worker_counts[] = { 1, 2, 4 };
+	for (unsigned int i = 0; i < fixture_count; i++) {
+		struct ui_state_t state;
+		if (!bench_load_fixture(&state, fixtures[i])) {
+			exit(EXIT_FAILURE);
+		}
+		for (unsigned int j = 0; j < sizeof(worker_counts) / sizeof(unsigned int); j++) {
+			bench_fixture(fixtures[i], &state, worker_counts[j], frame_times, frames);
+		}
+	}
+
+	free(frame_times);
+	cairo_cleanup();
+	return 0;
+}
@@ -25,149 +25,115 @@
 #include <stdlib.h>
 #include <string.h>
 #include "display.h"
-#include "display_fb.h"
 #include "cairo.h"
 #include "cairoglue.h"
 #include "display_sdl.h"
 #include "historian.h"
 #include "tools.h"
-#include "isleep.h"
+#include "framesched.h"
 #include "signals.h"
 #include "cyberblades-ui.h"
-#include "renderer_fullhd.h"
+#include "renderer.h"
+#include "presenter.h"
+#include "output.h"
+#include "eventloop.h"
+#include "playercache.h"
+#include "uistate.h"
 
-static bool string_is(const char *str1, const char *str2) {
-	if (!str1 || !str2) {
-		return false;
-	}
-	return !strcmp(str1, str2);
+static void set_player(struct server_state_t *server_state, const char *new_player) {
+	historian_command(server_state->historian, "set_player", "\"player\":\"%s\"", new_player);
 }
 
-static void parse_performance(struct performance_info_t *performance, struct jsondom_t *json) {
-	performance->score = jsondom_get_dict_int(json, "score");
-	performance->max_score = jsondom_get_dict_int(json, "max_score");
-	performance->combo = jsondom_get_dict_int(json, "combo");
-	performance->max_combo = jsondom_get_dict_int(json, "max_combo");
-	performance->hit_notes = jsondom_get_dict_int(json, "hit_notes");
-	performance->passed_notes = jsondom_get_dict_int(json, "passed_notes");
-	performance->missed_notes = jsondom_get_dict_int(json, "missed_notes");
-	const char *rank = jsondom_get_dict_str(json, "rank");
-	if (rank) {
-		strncpy(performance->rank, rank, sizeof(performance->rank) - 1);
-	} else {
-		performance->rank[0] = 0;
+/* A player that was switched back to is shown from the cache right away and
+ * revalidated in the background. Cached highscores are only shown for the
+ * song that was last reported; only as long as no song is known, the most
+ * recent entry of the player is used. Once a game has finished, the
+ * information is outdated and requested again even if a request is still in
+ * flight. */
+static void request_player_information(struct server_state_t *server_state, enum playerinfo_refresh_t refresh) {
+	if (refresh == PLAYERINFO_PLAYER_CHANGED) {
+		const struct song_metadata_t *current_song = &server_state->state.current_song.meta;
+		const struct playercache_entry_t *cached = playercache_lookup(server_state->playercache, server_state->state.player.name, current_song->song_title[0] ? current_song : NULL);
+		if (cached) {
+			ui_state_apply_playerinfo(&server_state->state, &cached->player, &cached->highscores);
+		}
 	}
-	performance->verdict_passed = string_is(jsondom_get_dict_str(json, "verdict"), "pass");
+	historian_request(server_state->historian, refresh != PLAYERINFO_OUTDATED, "playerinfo", "\"player\":\"%s\"", server_state->state.player.name);
 }
 
-static void parse_game_info(struct song_info_t *song, struct jsondom_t *song_json) {
-	struct jsondom_t *json_current_game_perf = jsondom_get_dict_dict(song_json, "performance");
-	if (json_current_game_perf) {
-		parse_performance(&song->performance, json_current_game_perf);
-	} else {
-		memset(&song->performance, 0, sizeof(song->performance));
-	}
+/* Setting the status mode again also makes the historian start over with a
+ * full status snapshot */
+static void request_status_deltas(struct server_state_t *server_state) {
+	server_state->status_sequence_valid = false;
+	server_state->status_mode_request_id = historian_request(server_state->historian, true, "set_status_mode", "\"delta\":true");
+}
 
-	struct jsondom_t *json_current_game_meta = jsondom_get_dict_dict(song_json, "meta");
-	if (json_current_game_meta) {
-		const char *song_author = jsondom_get_dict_str(json_current_game_meta, "song_author");
-		if (song_author) {
-			strncpy(song->meta.song_author, song_author, sizeof(song->meta.song_author) - 1);
-		}
-		const char *song_title = jsondom_get_dict_str(json_current_game_meta, "song_title");
-		if (song_title) {
-			strncpy(song->meta.song_title, song_title, sizeof(song->meta.song_title) - 1);
+/* Historians that do not know about delta mode reject the request and keep
+ * sending full status messages. Ones that predate request IDs can only be
+ * told apart by the error text. */
+static bool event_handle_historian_error(struct server_state_t *server_state, const struct ui_event_historian_msg_t *event) {
+	if (!server_state->status_mode_request_id) {
+		return false;
+	}
+	if (event->request_id) {
+		if (event->request_id != server_state->status_mode_request_id) {
+			return false;
 		}
-		const char *level_author = jsondom_get_dict_str(json_current_game_meta, "level_author");
-		if (level_author) {
-			strncpy(song->meta.level_author, level_author, sizeof(song->meta.level_author) - 1);
+	} else {
+		const char *text = jsondom_get_dict_str(event->json, "text");
+		if (!text || !strstr(text, "set_status_mode")) {
+			return false;
 		}
 	}
-}
-
-static void parse_player_stats(struct player_stats_t *stats, struct jsondom_t *stat_json) {
-	stats->games_played = jsondom_get_dict_int(stat_json, "games_played");
-	stats->total_playtime_secs = jsondom_get_dict_float(stat_json, "total_playtime_secs");
-	stats->total_passed_notes = jsondom_get_dict_int(stat_json, "total_passed_notes");
-	stats->total_missed_notes = jsondom_get_dict_int(stat_json, "total_missed_notes");
-	stats->total_score = jsondom_get_dict_int(stat_json, "total_score");
-	stats->total_max_score = jsondom_get_dict_int(stat_json, "total_max_score");
-}
-
-static void set_player(struct server_state_t *server_state, const char *new_player) {
-	historian_command(server_state->historian, "set_player", "\"player\":\"%s\"", new_player);
-}
-
-static void request_player_information(struct server_state_t *server_state) {
-	historian_command(server_state->historian, "playerinfo", "\"player\":\"%s\"", server_state->player.name);
+	server_state->status_mode_request_id = 0;
+	fprintf(stderr, "Historian does not support status deltas, using full status updates.\n");
+	return true;
 }
 
 static void event_handle_historian_status(struct server_state_t *server_state, struct jsondom_t *json) {
-	struct jsondom_t *json_connection = jsondom_get_dict_dict(json, "connection");
-	struct jsondom_t *current_game = jsondom_get_dict_dict(json, "current_game");
-	if (json_connection) {
-		if (strncpycmp(server_state->player.name, jsondom_get_dict_str(json_connection, "current_player"), sizeof(server_state->player.name))) {
-			/* Player name has changed */
-			request_player_information(server_state);
-		}
-		server_state->connected_to_beatsaber = jsondom_get_dict_bool(json_connection, "connected_to_beatsaber");
-
-		bool in_game = current_game != NULL;
-		if (in_game) {
-			server_state->ui_screen = GAME_SCREEN;
-			server_state->screen_shown_at_ts = now();
-		} else {
-			if (server_state->ui_screen == GAME_SCREEN) {
-				/* Was playing a game, now back to main screen: Update
-				 * highscores! */
-				request_player_information(server_state);
-			}
-			server_state->ui_screen = MAIN_SCREEN;
-			server_state->screen_shown_at_ts = now();
-		}
+	enum playerinfo_refresh_t refresh = ui_state_apply_status(&server_state->state, json);
+	if (refresh != PLAYERINFO_CURRENT) {
+		request_player_information(server_state, refresh);
+	}
+	if (jsondom_get_dict(json, "seq")) {
+		/* Snapshot that starts a delta stream */
+		server_state->status_sequence = jsondom_get_dict_int(json, "seq");
+		server_state->status_sequence_valid = true;
 	}
-
-	parse_game_info(&server_state->current_song, current_game);
-	isleep_interrupt(&server_state->isleep);
 }
 
-static void parse_highscore_entry(struct highscore_entry_t *entry, struct jsondom_t *json) {
-	strncpycmp(entry->name, jsondom_get_dict_str(json, "player"), sizeof(entry->name));
-	entry->number = jsondom_get_dict_int(json, "number");
-	entry->most_recent = jsondom_get_dict_bool(json, "most_recent");
-	parse_performance(&entry->performance, json);
+static void event_handle_historian_status_delta(struct server_state_t *server_state, struct jsondom_t *json) {
+	int64_t sequence = jsondom_get_dict_int(json, "seq");
+	if (!server_state->status_sequence_valid || (sequence != server_state->status_sequence + 1)) {
+		/* Missed an update, every delta is useless until resynchronized */
+		request_status_deltas(server_state);
+		return;
+	}
+	server_state->status_sequence = sequence;
+	enum playerinfo_refresh_t refresh = ui_state_apply_status_delta(&server_state->state, jsondom_get_dict_dict(json, "changes"));
+	if (refresh != PLAYERINFO_CURRENT) {
+		request_player_information(server_state, refresh);
+	}
 }
 
+/* Responses are cached whichever player they are for, but only shown if
+ * they are for the current one */
 static void event_handle_historian_playerinfo(struct server_state_t *server_state, struct jsondom_t *json) {
-	jsondom_dump(json);
-	const char *player = jsondom_get_dict_str(json, "player");
-	if (!player || strcmp(player, server_state->player.name)) {
-		/* No player set or different player given */
+	struct player_info_t player;
+	struct highscore_table_t highscores;
+	if (!ui_state_parse_playerinfo(json, &player, &highscores)) {
 		return;
 	}
-	parse_player_stats(&server_state->player.today, jsondom_get_dict_dict(json, "today"));
-	parse_player_stats(&server_state->player.alltime, jsondom_get_dict_dict(json, "alltime"));
-
-	struct jsondom_t *highscore = jsondom_get_dict_dict(json, "highscore");
-	struct jsondom_t *highscore_song_key = jsondom_get_dict_dict(highscore, "song_key");
-	if (highscore_song_key) {
-		strncpycmp(server_state->highscores.song_key.song_author, jsondom_get_dict_str(highscore_song_key, "song_author"), sizeof(server_state->highscores.song_key.song_author));
-		strncpycmp(server_state->highscores.song_key.song_title, jsondom_get_dict_str(highscore_song_key, "song_title"), sizeof(server_state->highscores.song_key.song_title));
-		strncpycmp(server_state->highscores.song_key.level_author, jsondom_get_dict_str(highscore_song_key, "level_author"), sizeof(server_state->highscores.song_key.level_author));
-		server_state->highscores.song_key.difficulty = jsondom_get_dict_int(highscore_song_key, "difficulty");
-	}
+	playercache_store(server_state->playercache, &player, &highscores);
+	ui_state_apply_playerinfo(&server_state->state, &player, &highscores);
+}
 
-	struct jsondom_t *highscore_table = jsondom_get_dict_array(highscore, "table");
-	if (highscore_table) {
-		unsigned int highscore_entry_count = highscore_table->element.array.element_cnt;
-		server_state->highscores.entry_count = (highscore_entry_count > MAX_HIGHSCORE_ENTRY_COUNT) ? MAX_HIGHSCORE_ENTRY_COUNT : highscore_entry_count;
-		for (unsigned int i = 0; i < server_state->highscores.entry_count; i++) {
-			struct jsondom_t *highscore_entry = jsondom_get_array_item(highscore_table, i);
-			parse_highscore_entry(&server_state->highscores.entries[i], highscore_entry);
-		}
-	} else {
-		server_state->highscores.entry_count = 0;
-	}
+/* Must be called with shared_data_mutex held, which makes the event handlers
+ * the single writer of the snapshot buffer */
+static void publish_ui_state(struct server_state_t *server_state) {
+	struct ui_state_t *snapshot = tribuf_write_slot(server_state->snapshots);
+	*snapshot = server_state->state;
+	tribuf_publish(server_state->snapshots);
 }
 
 static void event_callback(enum ui_eventtype_t event_type, void *vevent, void *ctx) {
@@ -176,12 +142,15 @@ static void event_callback(enum ui_eventtype_t event_type, void *vevent, void *c
 	pthread_mutex_lock(&server_state->shared_data_mutex);
 
 	if (event_type == EVENT_QUIT) {
+		for (unsigned int i = 0; i < server_state->output_count; i++) {
+			output_print_stats(server_state->outputs[i]);
+		}
 		exit(EXIT_SUCCESS);
 	} else if (event_type == EVENT_KEYPRESS) {
 		struct ui_event_keypress_t *event = (struct ui_event_keypress_t*)vevent;
 		if (event->key == SDLK_BACKSPACE) {
-			char new_name[sizeof(server_state->player.name)];
-			strcpy(new_name, server_state->player.name);
+			char new_name[sizeof(server_state->state.player.name)];
+			strcpy(new_name, server_state->state.player.name);
 			int len = strlen(new_name);
 			if (len) {
 				new_name[len - 1] = 0;
@@ -190,11 +159,11 @@ static void event_callback(enum ui_eventtype_t event_type, void *vevent, void *c
 		}
 	} else if (event_type == EVENT_TEXTDATA) {
 		struct ui_event_textdata_t *event = (struct ui_event_textdata_t*)vevent;
-		int len = strlen(server_state->player.name);
+		int len = strlen(server_state->state.player.name);
 		int add_len = strlen(event->text);
-		if (len + add_len < sizeof(server_state->player.name)) {
-			char new_name[sizeof(server_state->player.name)];
-			strcpy(new_name, server_state->player.name);
+		if (len + add_len < sizeof(server_state->state.player.name)) {
+			char new_name[sizeof(server_state->state.player.name)];
+			strcpy(new_name, server_state->state.player.name);
 			strcat(new_name, event->text);
 			set_player(server_state, new_name);
 		}
@@ -206,6 +175,13 @@ static void event_callback(enum ui_eventtype_t event_type, void *vevent, void *c
 		if (msgtype) {
 			if (!strcmp(msgtype, "status")) {
 				event_handle_historian_status(server_state, event->json);
+			} else if (!strcmp(msgtype, "status_delta")) {
+				event_handle_historian_status_delta(server_state, event->json);
+			} else if (!strcmp(msgtype, "set_status_mode")) {
+				/* Acknowledged, the snapshot follows */
+				server_state->status_mode_request_id = 0;
+			} else if (!strcmp(msgtype, "error") && event_handle_historian_error(server_state, event)) {
+				/* Handled */
 			} else if (!strcmp(msgtype, "playerinfo")) {
 				event_handle_historian_playerinfo(server_state, event->json);
 			} else {
@@ -218,67 +194,197 @@ static void event_callback(enum ui_eventtype_t event_type, void *vevent, void *c
 		}
 	} else if (event_type == EVENT_HISTORIAN_STATECHG) {
 		struct ui_event_historian_statechg_t *event = (struct ui_event_historian_statechg_t*)vevent;
+		server_state->state.historian_state = event->new_state;
 		if (event->new_state == UNCONNECTED) {
-			server_state->connected_to_beatsaber = false;
-			server_state->ui_screen = MAIN_SCREEN;
-			server_state->screen_shown_at_ts = now();
-			isleep_interrupt(&server_state->isleep);
+			server_state->state.connected_to_beatsaber = false;
+			server_state->state.ui_screen = MAIN_SCREEN;
+			server_state->state.screen_shown_at_ts = now();
+			server_state->status_sequence_valid = false;
+			server_state->status_mode_request_id = 0;
+		} else if (USE_STATUS_DELTAS) {
+			request_status_deltas(server_state);
 		}
 	}
+	publish_ui_state(server_state);
 	pthread_mutex_unlock(&server_state->shared_data_mutex);
+
+	/* Every event may have changed what is on screen; connection state
+	 * changes are always shown, even if they did not touch the screen */
+	framesched_mark_dirty(&server_state->framesched);
+}
+
+static void render_frame(struct server_state_t *server_state) {
+	server_state->frameno++;
+	/* Rendering works on an immutable snapshot, so event handlers are
+	 * never held up by a frame that is being drawn */
+	const struct ui_state_t *ui_state = tribuf_read(server_state->snapshots);
+
+	/* The outputs share the tiling workers, so they are rendered one
+	 * after the other; presenting them overlaps on their own threads */
+	for (unsigned int i = 0; i < server_state->output_count; i++) {
+		output_render(server_state->outputs[i], ui_state);
+	}
+	if ((server_state->frameno % 1000) == 0) {
+		for (unsigned int i = 0; i < server_state->output_count; i++) {
+			output_print_stats(server_state->outputs[i]);
+		}
+#ifdef DEVELOPMENT
+		swbuf_print_cache_stats();
+		fprintf(stderr, "Historian: %lu outdated status messages skipped\n", historian_get_skipped_status_messages(server_state->historian));
+#endif
+	}
+}
+
+static void eventloop_nop(struct eventloop_source_t *source, uint32_t events, void *ctx) {
+	/* Only there to make the loop run once more, the frame scheduler is
+	 * consulted after every round anyway */
+}
+
+static void eventloop_wakeup_cb(void *vwakeup) {
+	eventloop_wakeup((struct eventloop_source_t*)vwakeup);
+}
+
+/* Historian messages, signals and frame deadlines are all handled on this one
+ * thread. Only events from other threads, such as SDL input, go through the
+ * wakeup eventfd. Frames are rendered on this thread as well, so unlike with
+ * the historian's own threads, render time (and, when rendering directly to
+ * the display, waiting for vsync) delays message handling. */
+static void run_eventloop(struct server_state_t *server_state) {
+	struct eventloop_source_t *frame_timer = eventloop_add_timer(server_state->eventloop, eventloop_nop, NULL);
+	struct eventloop_source_t *wakeup = eventloop_add_wakeup(server_state->eventloop, eventloop_nop, NULL);
+	if (!frame_timer || !wakeup) {
+		fprintf(stderr, "Could not set up event loop sources.\n");
+		exit(EXIT_FAILURE);
+	}
+	framesched_set_wakeup(&server_state->framesched, eventloop_wakeup_cb, wakeup);
+
+	while (server_state->running) {
+		struct timespec due;
+		bool have_due;
+		if (framesched_poll(&server_state->framesched, &due, &have_due)) {
+			render_frame(server_state);
+			continue;
+		}
+		eventloop_timer_arm(frame_timer, have_due ? &due : NULL);
+		if (!eventloop_dispatch(server_state->eventloop)) {
+			break;
+		}
+	}
+
+	framesched_set_wakeup(&server_state->framesched, NULL, NULL);
+	eventloop_remove(frame_timer);
+	eventloop_remove(wakeup);
 }
 
 int main(int argc, char **argv) {
 	struct server_state_t server_state = {
-		.ui_screen = MAIN_SCREEN,
-		.screen_shown_at_ts = now(),
-		.isleep = ISLEEP_INITIALIZER,
+		.state = {
+			.ui_screen = MAIN_SCREEN,
+			.screen_shown_at_ts = now(),
+			.historian_state = UNCONNECTED,
+		},
+		.framesched = FRAMESCHED_INITIALIZER(MAX_FRAME_RATE),
 		.running = true,
 		.shared_data_mutex = PTHREAD_MUTEX_INITIALIZER,
 	};
 
-	struct display_t *display = NULL;
-	if (argc == 2) {
-		const char *filename = argv[1];
-		display = display_init(&display_fb_calltable, (void*)filename);
-	} else {
-		struct display_sdl_init_t init_params = {
-//			.width = 320, .height = 240,
-			.width = 1920, .height = 1080,
-		};
-		display = display_init(&display_sdl_calltable, &init_params);
-		display_sdl_register_events(display, event_callback, &server_state);
+	server_state.snapshots = tribuf_init(sizeof(struct ui_state_t), &server_state.state);
+	if (!server_state.snapshots) {
+		fprintf(stderr, "Could not create UI state snapshot buffer.\n");
+		exit(EXIT_FAILURE);
 	}
-	register_signal_handler(event_callback, &server_state);
 
-	cairo_addfont("../external/beon/beon-webfont.ttf");
-	cairo_addfont("../external/instruction/Instruction.ttf");
+	server_state.playercache = playercache_init();
+	if (!server_state.playercache) {
+		exit(EXIT_FAILURE);
+	}
+
+	if ((argc >= 2) && !strcmp(argv[1], "--help")) {
+		fprintf(stderr, "%s [output ...]\n", argv[0]);
+		fprintf(stderr, "  output: display[,renderer[,render scale]]\n");
+		fprintf(stderr, "  display: sdl, sdl:WxH, null:WxH, memory:WxH or a framebuffer device\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* Signals are only routed into the event loop if they are blocked
+	 * before any other thread is started */
+	if (USE_EVENT_LOOP) {
+		server_state.eventloop = eventloop_init();
+		if (!server_state.eventloop || !register_signal_eventloop(server_state.eventloop, event_callback, &server_state)) {
+			fprintf(stderr, "Could not create event loop.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	/* The rasterized text cache is shared by all outputs */
+	swbuf_set_text_cache_limit(TEXT_CACHE_MEMORY_LIMIT);
 
-	if (!display) {
-		fprintf(stderr, "Could not create display.\n");
+	/* Every output gets its own presenter; all of them are fed from the
+	 * same state snapshot, so one historian connection serves every screen */
+	const unsigned int output_count = (argc >= 2) ? (argc - 1) : 1;
+	if (output_count > MAX_OUTPUT_COUNT) {
+		fprintf(stderr, "At most %d outputs are supported.\n", MAX_OUTPUT_COUNT);
 		exit(EXIT_FAILURE);
 	}
+	struct output_t *sdl_output = NULL;
+	for (unsigned int i = 0; i < output_count; i++) {
+		struct output_t *output = output_init((argc >= 2) ? argv[1 + i] : "sdl");
+		if (!output) {
+			fprintf(stderr, "Could not create output.\n");
+			exit(EXIT_FAILURE);
+		}
+		if (output->sdl) {
+			if (sdl_output) {
+				fprintf(stderr, "Only one SDL output is supported.\n");
+				exit(EXIT_FAILURE);
+			}
+			sdl_output = output;
+			display_sdl_register_events(output->display, event_callback, &server_state);
+		}
+		server_state.outputs[server_state.output_count++] = output;
+	}
+	if (!server_state.eventloop) {
+		register_signal_handler(event_callback, &server_state);
+	}
+
+	cairo_addfont("../external/beon/beon-webfont.ttf");
+	cairo_addfont("../external/instruction/Instruction.ttf");
 
 	/* Start historian connection */
-	server_state.historian = historian_connect("../historian/unix_sock", event_callback, &server_state);
+	server_state.historian = historian_connect("../historian/unix_sock", server_state.eventloop, event_callback, &server_state);
 	if (!server_state.historian) {
 		fprintf(stderr, "Could not create historian connection instance.\n");
 		exit(EXIT_FAILURE);
 	}
 
-	struct cairo_swbuf_t *swbuf = create_swbuf(display->width, display->height);
-	while (server_state.running) {
-		server_state.frameno++;
-		pthread_mutex_lock(&server_state.shared_data_mutex);
-		swbuf_render_full_hd(&server_state, swbuf);
-		pthread_mutex_unlock(&server_state.shared_data_mutex);
-		blit_swbuf_on_display(swbuf, display);
-		display_commit(display);
-		isleep(&server_state.isleep, 50);
+	/* Tiled rendering splits each frame into one band per worker */
+	struct workpool_t *render_workers = NULL;
+	if (RENDER_WORKER_COUNT > 1) {
+		render_workers = workpool_init(RENDER_WORKER_COUNT);
+		for (unsigned int i = 0; i < server_state.output_count; i++) {
+			struct presenter_t *presenter = server_state.outputs[i]->presenter;
+			if (!render_workers || !presenter_set_tiling(presenter, render_workers, RENDER_WORKER_COUNT)) {
+				fprintf(stderr, "Could not set up tiled rendering, rendering single-threaded.\n");
+				presenter_set_tiling(presenter, NULL, 1);
+			}
+		}
+	}
+
+	if (server_state.eventloop) {
+		run_eventloop(&server_state);
+	} else {
+		while (server_state.running && framesched_wait(&server_state.framesched)) {
+			render_frame(&server_state);
+		}
 	}
 	historian_free(server_state.historian);
-	free_swbuf(swbuf);
-	display_free(display);
+	tribuf_free(server_state.snapshots);
+	playercache_free(server_state.playercache);
+	for (unsigned int i = 0; i < server_state.output_count; i++) {
+		output_free(server_state.outputs[i]);
+	}
+	workpool_free(render_workers);
+	eventloop_free(server_state.eventloop);
 
 	cairo_cleanup();
 	return 0;
@@ -24,11 +24,22 @@
 #define __CYBERBLADES_UI_H__
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <pthread.h>
-#include "isleep.h"
+#include "framesched.h"
+#include "historian.h"
+#include "tribuf.h"
 
 #define MAX_TEXT_WIDTH					48
 #define MAX_HIGHSCORE_ENTRY_COUNT		10
+#define MAX_FRAME_RATE					30
+#define RENDER_WORKER_COUNT				1
+#define RENDER_DIRECT_TO_DISPLAY		true
+#define RENDER_SCALE					1.0
+#define TEXT_CACHE_MEMORY_LIMIT			(16 * 1024 * 1024)
+#define MAX_OUTPUT_COUNT				4
+#define USE_EVENT_LOOP					false
+#define USE_STATUS_DELTAS				false
 
 
 enum ui_screen_t {
@@ -97,17 +108,37 @@ struct player_info_t {
 	struct player_stats_t alltime;
 };
 
-struct server_state_t {
+/* Everything the renderer needs; snapshots of this are handed to the render
+ * loop, so it must not contain any pointers */
+struct ui_state_t {
 	enum ui_screen_t ui_screen;
 	double screen_shown_at_ts;
 
+	enum historian_state_t historian_state;
 	bool connected_to_beatsaber;
 	struct player_info_t player;
 	struct song_info_t current_song;
 	struct highscore_table_t highscores;
+};
+
+struct server_state_t {
+	/* Modified by event handlers under shared_data_mutex and published
+	 * to the renderer through the snapshots triple buffer */
+	struct ui_state_t state;
+	struct tribuf_t *snapshots;
+	struct playercache_t *playercache;
+
+	/* Sequence number of the last status update of the historian's delta
+	 * stream; deltas are only applied on top of an unbroken sequence */
+	int64_t status_sequence;
+	bool status_sequence_valid;
+	unsigned int status_mode_request_id;
 
 	struct historian_t *historian;
-	struct isleep_t isleep;
+	struct eventloop_t *eventloop;
+	struct output_t *outputs[MAX_OUTPUT_COUNT];
+	unsigned int output_count;
+	struct framesched_t framesched;
 	bool running;
 	pthread_mutex_t shared_data_mutex;
 	unsigned int frameno;
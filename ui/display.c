@@ -41,6 +41,12 @@ void display_free(struct display_t *display) {
 	display->calltable->free(display);
 }
 
+void display_release(struct display_t *display) {
+	if (display->calltable->release) {
+		display->calltable->release(display);
+	}
+}
+
 void display_fill(struct display_t *display, uint32_t color) {
 	display->calltable->fill(display, color);
 }
@@ -51,6 +57,13 @@ void display_commit(struct display_t *display) {
 	}
 }
 
+bool display_get_draw_buffer(struct display_t *display, struct display_draw_buffer_t *buffer) {
+	if (!display->calltable->get_draw_buffer) {
+		return false;
+	}
+	return display->calltable->get_draw_buffer(display, buffer);
+}
+
 void display_put_pixel(struct display_t *display, unsigned int x, unsigned int y, uint32_t color) {
 	display->calltable->put_pixel(display, x, y, color);
 }
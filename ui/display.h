@@ -48,21 +48,51 @@ struct display_t {
 	uint8_t drv_context[];
 };
 
+/* A frame as produced by the renderer; bits_per_pixel is either 32 (ARGB32) or
+ * 16 (RGB565), both in native byte order */
+struct display_image_t {
+	const uint8_t *pixels;
+	unsigned int width, height;
+	unsigned int stride;
+	unsigned int bits_per_pixel;
+};
+
+struct display_rect_t {
+	unsigned int x, y;
+	unsigned int width, height;
+};
+
+/* Memory of a display page that can be drawn into directly; only offered by
+ * displays that flip pages, so that the page is never the one being shown */
+struct display_draw_buffer_t {
+	uint8_t *pixels;
+	unsigned int stride;
+	unsigned int page;
+};
+
 struct display_calltable_t {
 	bool (*init)(struct display_t *display, void *init_ctx);
 	void (*free)(struct display_t *display);
 	void (*fill)(struct display_t *display, uint32_t color);
 	void (*put_pixel)(struct display_t *display, unsigned int x, unsigned int y, uint32_t color);
 	void (*commit)(struct display_t *display);
-	bool (*blit_buffer)(struct display_t *display, uint32_t *source, unsigned int width, unsigned int height);
+	bool (*blit_buffer)(struct display_t *display, const struct display_image_t *image);
+	/* Only copies the given rectangles of the image, which is of display size */
+	bool (*blit_rects)(struct display_t *display, const struct display_image_t *image, const struct display_rect_t *rects, unsigned int rect_count);
+	bool (*get_draw_buffer)(struct display_t *display, struct display_draw_buffer_t *buffer);
+	/* Frees what was created by the thread drawing to the display; called
+	 * on that thread once it is done */
+	void (*release)(struct display_t *display);
 	unsigned int (*get_ctx_size)(void);
 };
 
 /*************** AUTO GENERATED SECTION FOLLOWS ***************/
 struct display_t* display_init(const struct display_calltable_t *calltable, void *init_ctx);
 void display_free(struct display_t *display);
+void display_release(struct display_t *display);
 void display_fill(struct display_t *display, uint32_t color);
 void display_commit(struct display_t *display);
+bool display_get_draw_buffer(struct display_t *display, struct display_draw_buffer_t *buffer);
 void display_put_pixel(struct display_t *display, unsigned int x, unsigned int y, uint32_t color);
 void display_test(struct display_t *display);
 /***************  AUTO GENERATED SECTION ENDS   ***************/
@@ -30,50 +30,36 @@
 #include <sys/ioctl.h>
 #include <string.h>
 #include "display_fb.h"
+#include "pixelops.h"
 
 #define BITMASK(bits)				((1 << (bits)) - 1)
 #define TRUNCATE_TO_BITS(x, bits)	((((x) / (1 << (8 - (bits))) & BITMASK(bits))))
 
-static unsigned int display_get_mapped_size(const struct display_t *display) {
-	return display->width * display->height * display->bits_per_pixel / 8;
+/* Pixels are always written to this page; with page flipping, that's the page
+ * currently not being scanned out */
+static uint8_t *display_fb_draw_page(const struct display_t *display) {
+	const struct display_fb_ctx_t *ctx = (const struct display_fb_ctx_t*)display->drv_context;
+	return ctx->screen + (ctx->back_page * display->height * ctx->line_length);
 }
 
-static void display_fill_16bit(struct display_t *display, uint16_t pixel) {
-	struct display_fb_ctx_t *ctx = (struct display_fb_ctx_t*)display->drv_context;
-	if (display->bits_per_pixel != 16) {
-		fprintf(stderr, "not 16bpp screen\n");
-		return;
-	}
-	uint16_t *screen = (uint16_t*)ctx->screen;
-	for (unsigned int i = 0; i < display->width * display->height; i++) {
-		*screen = pixel;
-		screen++;
-	}
-}
-
-static void display_fill_32bit(struct display_t *display, uint32_t pixel) {
+static void display_put_16bit(struct display_t *display, unsigned int x, unsigned int y, uint16_t pixel) {
 	struct display_fb_ctx_t *ctx = (struct display_fb_ctx_t*)display->drv_context;
-	if (display->bits_per_pixel != 32) {
-		fprintf(stderr, "not 32bpp screen\n");
-		return;
-	}
-	uint32_t *screen = (uint32_t*)ctx->screen;
-	for (unsigned int i = 0; i < display->width * display->height; i++) {
-		*screen = pixel;
-		screen++;
-	}
+	uint16_t *screen = (uint16_t*)(display_fb_draw_page(display) + (y * ctx->line_length));
+	screen[x] = pixel;
 }
 
-static void display_put_16bit(struct display_t *display, unsigned int x, unsigned int y, uint16_t pixel) {
+static void display_put_24bit(struct display_t *display, unsigned int x, unsigned int y, uint32_t rgb) {
 	struct display_fb_ctx_t *ctx = (struct display_fb_ctx_t*)display->drv_context;
-	uint16_t *screen = (uint16_t*)ctx->screen;
-	screen[(y * display->width) + x] = pixel;
+	uint8_t *screen = display_fb_draw_page(display) + (y * ctx->line_length) + (3 * x);
+	screen[0] = ctx->bgr ? GET_B(rgb) : GET_R(rgb);
+	screen[1] = GET_G(rgb);
+	screen[2] = ctx->bgr ? GET_R(rgb) : GET_B(rgb);
 }
 
 static void display_put_32bit(struct display_t *display, unsigned int x, unsigned int y, uint32_t pixel) {
 	struct display_fb_ctx_t *ctx = (struct display_fb_ctx_t*)display->drv_context;
-	uint32_t *screen = (uint32_t*)ctx->screen;
-	screen[(y * display->width) + x] = pixel;
+	uint32_t *screen = (uint32_t*)(display_fb_draw_page(display) + (y * ctx->line_length));
+	screen[x] = pixel;
 }
 
 static uint16_t rgb_to_16bit(uint32_t rgb) {
@@ -87,6 +73,8 @@ static uint16_t rgb_to_16bit(uint32_t rgb) {
 static void display_fb_put_pixel(struct display_t *display, unsigned int x, unsigned int y, uint32_t rgb) {
 	if (display->bits_per_pixel == 32) {
 		display_put_32bit(display, x, y, rgb);
+	} else if (display->bits_per_pixel == 24) {
+		display_put_24bit(display, x, y, rgb);
 	} else if (display->bits_per_pixel == 16) {
 		uint16_t pixel = rgb_to_16bit(rgb);
 		display_put_16bit(display, x, y, pixel);
@@ -96,16 +84,66 @@ static void display_fb_put_pixel(struct display_t *display, unsigned int x, unsi
 }
 
 static void display_fb_fill(struct display_t *display, uint32_t rgb) {
+	struct display_fb_ctx_t *ctx = (struct display_fb_ctx_t*)display->drv_context;
+	uint8_t *page = display_fb_draw_page(display);
 	if (display->bits_per_pixel == 32) {
-		display_fill_32bit(display, rgb);
+		pixelops_fill32_rect(ctx->pixelops, page, ctx->line_length, rgb, display->width, display->height);
+	} else if (display->bits_per_pixel == 24) {
+		/* No 24 bit fill kernel, the first row is replicated instead */
+		for (unsigned int x = 0; x < display->width; x++) {
+			display_put_24bit(display, x, 0, rgb);
+		}
+		for (unsigned int y = 1; y < display->height; y++) {
+			memcpy(page + (y * ctx->line_length), page, 3 * display->width);
+		}
 	} else if (display->bits_per_pixel == 16) {
-		uint16_t pixel = rgb_to_16bit(rgb);
-		display_fill_16bit(display, pixel);
+		pixelops_fill16_rect(ctx->pixelops, page, ctx->line_length, rgb_to_16bit(rgb), display->width, display->height);
 	} else {
 		fprintf(stderr, "Don't know how to fill %d bpp screen.\n", display->bits_per_pixel);
 	}
 }
 
+/* Tries to get a virtual framebuffer of twice the visible height so that
+ * frames can be drawn into the invisible half and then panned to. Drivers that
+ * refuse simply keep a single page. */
+static void display_fb_setup_page_flipping(struct display_t *display) {
+	struct display_fb_ctx_t *ctx = (struct display_fb_ctx_t*)display->drv_context;
+	if ((display->bits_per_pixel != 16) && (display->bits_per_pixel != 24) && (display->bits_per_pixel != 32)) {
+		/* Only full frame blits are guaranteed to cover a whole back page,
+		 * the per-pixel fallback only copies what has changed */
+		return;
+	}
+
+	struct fb_var_screeninfo vinfo = ctx->original_vinfo;
+	vinfo.yres_virtual = 2 * vinfo.yres;
+	vinfo.yoffset = 0;
+	if (ioctl(ctx->fd, FBIOPUT_VSCREENINFO, &vinfo) == -1) {
+		fprintf(stderr, "Framebuffer driver refuses double height virtual screen, not page flipping.\n");
+		return;
+	}
+	ctx->vinfo_modified = true;
+
+	struct fb_fix_screeninfo finfo;
+	if ((ioctl(ctx->fd, FBIOGET_VSCREENINFO, &vinfo) == -1) || (ioctl(ctx->fd, FBIOGET_FSCREENINFO, &finfo) == -1)) {
+		perror("ioctl(FBIOGET_*SCREENINFO)");
+		return;
+	}
+	if ((vinfo.yres_virtual < 2 * display->height) || (finfo.smem_len < 2 * display->height * finfo.line_length)) {
+		fprintf(stderr, "Framebuffer has no room for a second page, not page flipping.\n");
+		return;
+	}
+
+	ctx->vinfo = vinfo;
+	ctx->line_length = finfo.line_length;
+	ctx->page_count = 2;
+	ctx->back_page = 1;
+	ctx->vsync = true;
+
+	/* Neither page has been drawn yet */
+	ctx->previous_rects[0] = (struct display_rect_t){ .width = display->width, .height = display->height };
+	ctx->previous_rect_count = 1;
+}
+
 static bool display_fb_init(struct display_t *display, void *init_ctx) {
 	const char *fbdev = (const char*)init_ctx;
 	struct display_fb_ctx_t *ctx = (struct display_fb_ctx_t*)display->drv_context;
@@ -121,18 +159,33 @@ static bool display_fb_init(struct display_t *display, void *init_ctx) {
 		return false;
 	}
 
-	struct fb_var_screeninfo vinfo;
-	if (ioctl(ctx->fd, FBIOGET_VSCREENINFO, &vinfo) == -1) {
+	if (ioctl(ctx->fd, FBIOGET_VSCREENINFO, &ctx->original_vinfo) == -1) {
 		perror("ioctl(FBIOGET_VSCREENINFO)");
 		display_free(display);
 		return false;
 	}
-	display->width = vinfo.xres;
-	display->height = vinfo.yres;
-	display->bits_per_pixel = vinfo.bits_per_pixel;
-	fprintf(stderr, "Initiated framebuffer device %d x %d pixels at %d BPP\n", display->width, display->height, display->bits_per_pixel);
+	struct fb_fix_screeninfo finfo;
+	if (ioctl(ctx->fd, FBIOGET_FSCREENINFO, &finfo) == -1) {
+		perror("ioctl(FBIOGET_FSCREENINFO)");
+		display_free(display);
+		return false;
+	}
+	ctx->vinfo = ctx->original_vinfo;
+	ctx->line_length = finfo.line_length;
+	ctx->page_count = 1;
+	ctx->back_page = 0;
+	display->width = ctx->vinfo.xres;
+	display->height = ctx->vinfo.yres;
+	display->bits_per_pixel = ctx->vinfo.bits_per_pixel;
+	ctx->pixelops = pixelops_get();
+	ctx->dither = FB_DITHER_RGB565;
+	ctx->bgr = (ctx->vinfo.red.offset == 16);
+
+	display_fb_setup_page_flipping(display);
+	fprintf(stderr, "Initiated framebuffer device %d x %d pixels at %d BPP, %s\n", display->width, display->height, display->bits_per_pixel, (ctx->page_count == 2) ? "page flipping" : "single page");
 
-	ctx->screen = (uint8_t*)mmap(0, display_get_mapped_size(display), PROT_READ | PROT_WRITE, MAP_SHARED, ctx->fd, 0);
+	ctx->mapped_size = ctx->page_count * display->height * ctx->line_length;
+	ctx->screen = (uint8_t*)mmap(0, ctx->mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, ctx->fd, 0);
 	if (ctx->screen == (void*)-1) {
 		perror("mmap");
 		ctx->screen = NULL;
@@ -145,11 +198,14 @@ static bool display_fb_init(struct display_t *display, void *init_ctx) {
 static void display_fb_free(struct display_t *display) {
 	struct display_fb_ctx_t *ctx = (struct display_fb_ctx_t*)display->drv_context;
 	if (ctx->screen) {
-		if (munmap(ctx->screen, display_get_mapped_size(display))) {
+		if (munmap(ctx->screen, ctx->mapped_size)) {
 			perror("munmap");
 		}
 	}
 	if (ctx->fd != -1) {
+		if (ctx->vinfo_modified && (ioctl(ctx->fd, FBIOPUT_VSCREENINFO, &ctx->original_vinfo) == -1)) {
+			perror("ioctl(FBIOPUT_VSCREENINFO)");
+		}
 		close(ctx->fd);
 	}
 }
@@ -158,16 +214,106 @@ static unsigned int display_fb_get_ctx_size(void) {
 	return sizeof(struct display_fb_ctx_t);
 }
 
-static bool display_fb_blit_buffer(struct display_t *display, uint32_t *source, unsigned int width, unsigned int height) {
-	if (display->bits_per_pixel != 32) {
+/* Leaves page flipping mode after the driver refused to pan; the page that was
+ * just drawn is copied to the visible page so that it isn't lost */
+static void display_fb_disable_page_flipping(struct display_t *display) {
+	struct display_fb_ctx_t *ctx = (struct display_fb_ctx_t*)display->drv_context;
+	fprintf(stderr, "Panning framebuffer failed, falling back to single page.\n");
+	if (ctx->back_page != 0) {
+		memcpy(ctx->screen, display_fb_draw_page(display), display->height * ctx->line_length);
+	}
+	ctx->page_count = 1;
+	ctx->back_page = 0;
+}
+
+static void display_fb_commit(struct display_t *display) {
+	struct display_fb_ctx_t *ctx = (struct display_fb_ctx_t*)display->drv_context;
+	if (ctx->page_count < 2) {
+		return;
+	}
+
+	ctx->vinfo.yoffset = ctx->back_page * display->height;
+	if (ioctl(ctx->fd, FBIOPAN_DISPLAY, &ctx->vinfo) == -1) {
+		display_fb_disable_page_flipping(display);
+		return;
+	}
+	if (ctx->vsync) {
+		/* Don't start drawing into the page that is still being scanned out */
+		uint32_t crtc = 0;
+		if (ioctl(ctx->fd, FBIO_WAITFORVSYNC, &crtc) == -1) {
+			ctx->vsync = false;
+		}
+	}
+	ctx->back_page = (ctx->back_page + 1) % ctx->page_count;
+}
+
+static bool display_fb_can_blit(const struct display_t *display, const struct display_image_t *image) {
+	if (image->bits_per_pixel == display->bits_per_pixel) {
+		return true;
+	}
+	return (image->bits_per_pixel == 32) && ((display->bits_per_pixel == 16) || (display->bits_per_pixel == 24));
+}
+
+static void display_fb_blit_rect(struct display_t *display, const struct display_image_t *image, const struct display_rect_t *rect) {
+	struct display_fb_ctx_t *ctx = (struct display_fb_ctx_t*)display->drv_context;
+	uint8_t *dest = display_fb_draw_page(display) + (rect->y * ctx->line_length) + (rect->x * display->bits_per_pixel / 8);
+	const uint8_t *src = image->pixels + (rect->y * image->stride) + (rect->x * image->bits_per_pixel / 8);
+	if (image->bits_per_pixel == display->bits_per_pixel) {
+		/* Rendered in the screen's native format, nothing to convert */
+		pixelops_copy_rect(dest, ctx->line_length, src, image->stride, rect->width * image->bits_per_pixel / 8, rect->height);
+	} else if (display->bits_per_pixel == 24) {
+		pixelops_argb32_to_rgb24_rect(ctx->pixelops, dest, ctx->line_length, (const uint32_t*)src, image->stride, rect->width, rect->height, ctx->bgr);
+	} else {
+		pixelops_argb32_to_rgb565_rect(ctx->pixelops, dest, ctx->line_length, (const uint32_t*)src, image->stride, rect->x, rect->y, rect->width, rect->height, ctx->dither);
+	}
+}
+
+/* With page flipping, the back page still shows the frame before the one
+ * that is currently displayed. It therefore needs what changed in this frame
+ * plus whatever changed in the previous one. */
+static bool display_fb_blit_rects(struct display_t *display, const struct display_image_t *image, const struct display_rect_t *rects, unsigned int rect_count) {
+	struct display_fb_ctx_t *ctx = (struct display_fb_ctx_t*)display->drv_context;
+	if (!display_fb_can_blit(display, image)) {
 		return false;
 	}
-	if ((width != display->width) || (height != display->height)) {
+
+	for (unsigned int i = 0; i < rect_count; i++) {
+		display_fb_blit_rect(display, image, &rects[i]);
+	}
+	if (ctx->page_count < 2) {
+		return true;
+	}
+
+	for (unsigned int i = 0; i < ctx->previous_rect_count; i++) {
+		display_fb_blit_rect(display, image, &ctx->previous_rects[i]);
+	}
+	if (rect_count <= DISPLAY_FB_MAX_PREVIOUS_RECTS) {
+		memcpy(ctx->previous_rects, rects, sizeof(struct display_rect_t) * rect_count);
+		ctx->previous_rect_count = rect_count;
+	} else {
+		ctx->previous_rects[0] = (struct display_rect_t){ .width = display->width, .height = display->height };
+		ctx->previous_rect_count = 1;
+	}
+	return true;
+}
+
+static bool display_fb_blit_buffer(struct display_t *display, const struct display_image_t *image) {
+	if ((image->width != display->width) || (image->height != display->height)) {
 		return false;
 	}
+	return display_fb_blit_rects(display, image, &(const struct display_rect_t){ .width = image->width, .height = image->height }, 1);
+}
 
+/* Cairo can render straight into the back page, but only while page flipping
+ * is active: with a single page, partially drawn frames would be visible */
+static bool display_fb_get_draw_buffer(struct display_t *display, struct display_draw_buffer_t *buffer) {
 	struct display_fb_ctx_t *ctx = (struct display_fb_ctx_t*)display->drv_context;
-	memcpy(ctx->screen, source, sizeof(uint32_t) * width * height);
+	if ((ctx->page_count < 2) || ((display->bits_per_pixel != 16) && (display->bits_per_pixel != 32)) || (ctx->line_length % 4)) {
+		return false;
+	}
+	buffer->pixels = display_fb_draw_page(display);
+	buffer->stride = ctx->line_length;
+	buffer->page = ctx->back_page;
 	return true;
 }
 
@@ -175,7 +321,10 @@ const struct display_calltable_t display_fb_calltable = {
 	.init = display_fb_init,
 	.free = display_fb_free,
 	.fill = display_fb_fill,
+	.commit = display_fb_commit,
 	.put_pixel = display_fb_put_pixel,
 	.get_ctx_size = display_fb_get_ctx_size,
 	.blit_buffer = display_fb_blit_buffer,
+	.blit_rects = display_fb_blit_rects,
+	.get_draw_buffer = display_fb_get_draw_buffer,
 };
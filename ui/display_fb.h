@@ -25,13 +25,32 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <linux/fb.h>
 
 #include "display.h"
 #include "colors.h"
 
+/* Ordered dithering hides the banding of gradients on 16 bpp screens */
+#define FB_DITHER_RGB565			true
+
+#define DISPLAY_FB_MAX_PREVIOUS_RECTS	16
+
 struct display_fb_ctx_t {
 	int fd;
 	uint8_t *screen;
+	unsigned int mapped_size;
+	unsigned int line_length;
+	struct fb_var_screeninfo vinfo;
+	struct fb_var_screeninfo original_vinfo;
+	bool vinfo_modified;
+	unsigned int page_count;
+	unsigned int back_page;
+	bool vsync;
+	const struct pixelops_t *pixelops;
+	bool dither;
+	bool bgr;
+	struct display_rect_t previous_rects[DISPLAY_FB_MAX_PREVIOUS_RECTS];
+	unsigned int previous_rect_count;
 };
 
 extern const struct display_calltable_t display_fb_calltable;
@@ -0,0 +1,174 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "display_null.h"
+#include "tools.h"
+
+static bool display_null_init(struct display_t *display, void *init_ctx) {
+	struct display_null_ctx_t *ctx = (struct display_null_ctx_t*)display->drv_context;
+	struct display_null_init_t *initctx = (struct display_null_init_t*)init_ctx;
+	display->width = initctx->width;
+	display->height = initctx->height;
+	display->bits_per_pixel = 32;
+	pthread_mutex_init(&ctx->mutex, NULL);
+	return true;
+}
+
+static bool display_memory_init(struct display_t *display, void *init_ctx) {
+	struct display_null_ctx_t *ctx = (struct display_null_ctx_t*)display->drv_context;
+	if (!display_null_init(display, init_ctx)) {
+		return false;
+	}
+	ctx->frame = calloc(sizeof(uint32_t), display->width * display->height);
+	ctx->committed_frame = calloc(sizeof(uint32_t), display->width * display->height);
+	if (!ctx->frame || !ctx->committed_frame) {
+		perror("calloc");
+		return false;
+	}
+	return true;
+}
+
+static void display_null_free(struct display_t *display) {
+	struct display_null_ctx_t *ctx = (struct display_null_ctx_t*)display->drv_context;
+	free(ctx->frame);
+	free(ctx->committed_frame);
+	ctx->frame = NULL;
+	ctx->committed_frame = NULL;
+}
+
+static void display_null_fill(struct display_t *display, uint32_t rgb) {
+	struct display_null_ctx_t *ctx = (struct display_null_ctx_t*)display->drv_context;
+	if (ctx->frame) {
+		for (unsigned int i = 0; i < display->width * display->height; i++) {
+			ctx->frame[i] = rgb;
+		}
+	}
+	pthread_mutex_lock(&ctx->mutex);
+	ctx->stats.fills++;
+	pthread_mutex_unlock(&ctx->mutex);
+}
+
+static void display_null_put_pixel(struct display_t *display, unsigned int x, unsigned int y, uint32_t rgb) {
+	struct display_null_ctx_t *ctx = (struct display_null_ctx_t*)display->drv_context;
+	if (ctx->frame) {
+		ctx->frame[(y * display->width) + x] = rgb;
+	}
+	pthread_mutex_lock(&ctx->mutex);
+	ctx->stats.pixels_put++;
+	ctx->stats.bytes_copied += sizeof(uint32_t);
+	pthread_mutex_unlock(&ctx->mutex);
+}
+
+static void display_null_commit(struct display_t *display) {
+	struct display_null_ctx_t *ctx = (struct display_null_ctx_t*)display->drv_context;
+	if (ctx->committed_frame) {
+		memcpy(ctx->committed_frame, ctx->frame, sizeof(uint32_t) * display->width * display->height);
+	}
+	const double commit_ts = now();
+	pthread_mutex_lock(&ctx->mutex);
+	if (!ctx->stats.commits) {
+		ctx->stats.first_commit_ts = commit_ts;
+	}
+	ctx->stats.last_commit_ts = commit_ts;
+	ctx->stats.commits++;
+	pthread_mutex_unlock(&ctx->mutex);
+}
+
+static unsigned int display_null_get_ctx_size(void) {
+	return sizeof(struct display_null_ctx_t);
+}
+
+static bool display_null_blit_rects(struct display_t *display, const struct display_image_t *image, const struct display_rect_t *rects, unsigned int rect_count) {
+	if (image->bits_per_pixel != 32) {
+		return false;
+	}
+
+	struct display_null_ctx_t *ctx = (struct display_null_ctx_t*)display->drv_context;
+	unsigned long long bytes_copied = 0;
+	for (unsigned int i = 0; i < rect_count; i++) {
+		const struct display_rect_t *rect = &rects[i];
+		const unsigned int row_length = sizeof(uint32_t) * rect->width;
+		if (ctx->frame) {
+			for (unsigned int y = rect->y; y < rect->y + rect->height; y++) {
+				memcpy(ctx->frame + (y * display->width) + rect->x, image->pixels + (y * image->stride) + (sizeof(uint32_t) * rect->x), row_length);
+			}
+		}
+		bytes_copied += row_length * rect->height;
+	}
+	pthread_mutex_lock(&ctx->mutex);
+	ctx->stats.blits++;
+	ctx->stats.bytes_copied += bytes_copied;
+	pthread_mutex_unlock(&ctx->mutex);
+	return true;
+}
+
+static bool display_null_blit_buffer(struct display_t *display, const struct display_image_t *image) {
+	if ((image->width != display->width) || (image->height != display->height)) {
+		return false;
+	}
+	return display_null_blit_rects(display, image, &(const struct display_rect_t){ .width = image->width, .height = image->height }, 1);
+}
+
+void display_null_get_stats(struct display_t *display, struct display_null_stats_t *stats) {
+	struct display_null_ctx_t *ctx = (struct display_null_ctx_t*)display->drv_context;
+	pthread_mutex_lock(&ctx->mutex);
+	*stats = ctx->stats;
+	pthread_mutex_unlock(&ctx->mutex);
+}
+
+void display_null_print_stats(struct display_t *display) {
+	struct display_null_stats_t stats;
+	display_null_get_stats(display, &stats);
+	const double duration = stats.last_commit_ts - stats.first_commit_ts;
+	fprintf(stderr, "Display: %lu blits, %lu commits (%.1f/s), %lu fills, %lu pixels put, %.1f MiB copied\n", stats.blits, stats.commits, (duration > 0) ? (stats.commits - 1) / duration : 0., stats.fills, stats.pixels_put, stats.bytes_copied / 1024. / 1024.);
+}
+
+/* Returns NULL for the null display */
+const uint32_t *display_memory_get_committed_frame(struct display_t *display) {
+	struct display_null_ctx_t *ctx = (struct display_null_ctx_t*)display->drv_context;
+	return ctx->committed_frame;
+}
+
+const struct display_calltable_t display_null_calltable = {
+	.init = display_null_init,
+	.free = display_null_free,
+	.fill = display_null_fill,
+	.commit = display_null_commit,
+	.put_pixel = display_null_put_pixel,
+	.get_ctx_size = display_null_get_ctx_size,
+	.blit_buffer = display_null_blit_buffer,
+	.blit_rects = display_null_blit_rects,
+};
+
+const struct display_calltable_t display_memory_calltable = {
+	.init = display_memory_init,
+	.free = display_null_free,
+	.fill = display_null_fill,
+	.commit = display_null_commit,
+	.put_pixel = display_null_put_pixel,
+	.get_ctx_size = display_null_get_ctx_size,
+	.blit_buffer = display_null_blit_buffer,
+	.blit_rects = display_null_blit_rects,
+};
@@ -0,0 +1,62 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#ifndef __DISPLAY_NULL_H__
+#define __DISPLAY_NULL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "display.h"
+
+struct display_null_stats_t {
+	unsigned long blits;
+	unsigned long commits;
+	unsigned long fills;
+	unsigned long pixels_put;
+	unsigned long long bytes_copied;
+	double first_commit_ts, last_commit_ts;
+};
+
+struct display_null_ctx_t {
+	pthread_mutex_t mutex;
+	struct display_null_stats_t stats;
+	uint32_t *frame;
+	uint32_t *committed_frame;
+};
+
+struct display_null_init_t {
+	unsigned int width, height;
+};
+
+/* The null display discards everything, the memory display keeps the last
+ * committed frame in RAM. Both only count what is being sent to them. */
+extern const struct display_calltable_t display_null_calltable;
+extern const struct display_calltable_t display_memory_calltable;
+
+/*************** AUTO GENERATED SECTION FOLLOWS ***************/
+void display_null_get_stats(struct display_t *display, struct display_null_stats_t *stats);
+void display_null_print_stats(struct display_t *display);
+const uint32_t *display_memory_get_committed_frame(struct display_t *display);
+/***************  AUTO GENERATED SECTION ENDS   ***************/
+
+#endif
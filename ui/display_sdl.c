@@ -24,31 +24,105 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <string.h>
 #include "display_sdl.h"
 #include "ui_events.h"
 
-static void display_sdl_put_pixel(struct display_t *display, unsigned int x, unsigned int y, uint32_t rgb) {
+/* The SDL render API may only be used from the thread that created the
+ * renderer. Renderer and texture are therefore created on first use, i.e., by
+ * the thread that presents frames, and released by that thread again. */
+static bool display_sdl_prepare(struct display_t *display) {
 	struct display_sdl_ctx_t *ctx = (struct display_sdl_ctx_t*)display->drv_context;
-	uint32_t *target = (uint32_t*)((uint8_t *)ctx->surface->pixels + (y * ctx->surface->pitch) + (x * sizeof(uint32_t)));
-	*target = rgb;
+	if (ctx->texture) {
+		return true;
+	}
+	if (ctx->renderer_failed) {
+		return false;
+	}
 
+	ctx->renderer = SDL_CreateRenderer(ctx->window, -1, SDL_RENDERER_ACCELERATED | (ctx->vsync ? SDL_RENDERER_PRESENTVSYNC : 0));
+	if (!ctx->renderer) {
+		fprintf(stderr, "Could not create SDL renderer: %s\n", SDL_GetError());
+		ctx->renderer_failed = true;
+		return false;
+	}
+
+	/* Frames are uploaded into this texture in place instead of creating a
+	 * new texture for every frame */
+	ctx->texture = SDL_CreateTexture(ctx->renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, display->width, display->height);
+	if (!ctx->texture) {
+		fprintf(stderr, "Could not create SDL streaming texture: %s\n", SDL_GetError());
+		SDL_DestroyRenderer(ctx->renderer);
+		ctx->renderer = NULL;
+		ctx->renderer_failed = true;
+		return false;
+	}
+	return true;
+}
+
+static void display_sdl_release(struct display_t *display) {
+	struct display_sdl_ctx_t *ctx = (struct display_sdl_ctx_t*)display->drv_context;
+	if (ctx->texture) {
+		SDL_DestroyTexture(ctx->texture);
+		ctx->texture = NULL;
+	}
+	if (ctx->renderer) {
+		SDL_DestroyRenderer(ctx->renderer);
+		ctx->renderer = NULL;
+	}
+}
+
+/* Uploads one rectangle of a source buffer with the dimensions of the display
+ * into the streaming texture, i.e., only the pixels inside the rectangle are
+ * transferred */
+static bool display_sdl_update_rect(struct display_t *display, const struct display_image_t *image, const SDL_Rect *rect) {
+	struct display_sdl_ctx_t *ctx = (struct display_sdl_ctx_t*)display->drv_context;
+	if (!display_sdl_prepare(display)) {
+		return false;
+	}
+	const uint8_t *src = image->pixels + (rect->y * image->stride) + (rect->x * sizeof(uint32_t));
+	if (SDL_UpdateTexture(ctx->texture, rect, src, image->stride)) {
+		fprintf(stderr, "Could not update SDL texture: %s\n", SDL_GetError());
+		return false;
+	}
+	return true;
+}
+
+static void display_sdl_put_pixel(struct display_t *display, unsigned int x, unsigned int y, uint32_t rgb) {
+	struct display_sdl_ctx_t *ctx = (struct display_sdl_ctx_t*)display->drv_context;
+	if (display_sdl_prepare(display)) {
+		SDL_UpdateTexture(ctx->texture, &(const SDL_Rect){ .x = x, .y = y, .w = 1, .h = 1 }, &rgb, sizeof(uint32_t));
+	}
 }
 
 static void display_sdl_commit(struct display_t *display) {
 	struct display_sdl_ctx_t *ctx = (struct display_sdl_ctx_t*)display->drv_context;
-	SDL_UpdateWindowSurface(ctx->window);
-	SDL_RenderPresent(ctx->renderer);
+	if (display_sdl_prepare(display)) {
+		/* The texture always holds the complete frame; with vsync enabled,
+		 * presenting waits for the next vertical blank */
+		SDL_RenderCopy(ctx->renderer, ctx->texture, NULL, NULL);
+		SDL_RenderPresent(ctx->renderer);
+	}
 }
 
 static void display_sdl_fill(struct display_t *display, uint32_t rgb) {
 	struct display_sdl_ctx_t *ctx = (struct display_sdl_ctx_t*)display->drv_context;
-	if (!ctx->renderer) {
-		SDL_FillRect(ctx->surface, NULL, SDL_MapRGB(ctx->surface->format, GET_R(rgb), GET_G(rgb), GET_B(rgb)));
-		SDL_UpdateWindowSurface(ctx->window);
-	} else {
-		SDL_SetRenderDrawColor(ctx->renderer, GET_R(rgb), GET_G(rgb), GET_B(rgb), 255);
-		SDL_RenderClear(ctx->renderer);
+	if (!display_sdl_prepare(display)) {
+		return;
+	}
+	void *pixels;
+	int pitch;
+	if (SDL_LockTexture(ctx->texture, NULL, &pixels, &pitch)) {
+		fprintf(stderr, "Could not lock SDL texture: %s\n", SDL_GetError());
+		return;
+	}
+	for (unsigned int y = 0; y < display->height; y++) {
+		uint32_t *row = (uint32_t*)((uint8_t*)pixels + (y * pitch));
+		for (unsigned int x = 0; x < display->width; x++) {
+			row[x] = rgb;
+		}
 	}
+	SDL_UnlockTexture(ctx->texture);
 }
 
 
@@ -115,6 +189,7 @@ static bool display_sdl_init(struct display_t *display, void *init_ctx) {
 	display->width = initctx->width;
 	display->height = initctx->height;
 	display->bits_per_pixel = 32;
+	ctx->vsync = initctx->vsync;
 
 	if (SDL_Init(SDL_INIT_VIDEO) < 0) {
 		  fprintf(stderr, "Could not initialize SDL: %s\n", SDL_GetError());
@@ -128,14 +203,6 @@ static bool display_sdl_init(struct display_t *display, void *init_ctx) {
 		return false;
 	}
 
-	ctx->renderer = SDL_CreateRenderer(ctx->window, -1, SDL_RENDERER_ACCELERATED);
-	if (!ctx->renderer) {
-		fprintf(stderr, "Could not create SDL renderer: %s\n", SDL_GetError());
-		SDL_DestroyWindow(ctx->window);
-		SDL_Quit();
-		return false;
-	}
-
 #ifndef DEVELOPMENT
 	/* Disable mouse cursor if not developing */
 	SDL_ShowCursor(SDL_DISABLE);
@@ -143,13 +210,12 @@ static bool display_sdl_init(struct display_t *display, void *init_ctx) {
 
 	SDL_StartTextInput();
 //	SDL_SetWindowFullscreen(ctx->window, SDL_WINDOW_FULLSCREEN);
-
-	ctx->surface = SDL_GetWindowSurface(ctx->window);
 	return true;
 }
 
 static void display_sdl_free(struct display_t *display) {
 	struct display_sdl_ctx_t *ctx = (struct display_sdl_ctx_t*)display->drv_context;
+	display_sdl_release(display);
 	SDL_DestroyWindow(ctx->window);
 	SDL_Quit();
 }
@@ -168,26 +234,39 @@ void display_sdl_register_events(struct display_t *display, ui_event_cb_t event_
 /* When we use an accelerated renderer, we simply cannot directly access the
  * target surface anymore (it's implicit), therefore, blit_buffer *must* work
  */
-static bool display_sdl_blit_buffer(struct display_t *display, uint32_t *source, unsigned int width, unsigned int height) {
-	struct display_sdl_ctx_t *ctx = (struct display_sdl_ctx_t*)display->drv_context;
-	SDL_Surface *surface = SDL_CreateRGBSurfaceFrom(source, width, height, 32, 4 * width, COLOR_RMASK, COLOR_GMASK, COLOR_BMASK, 0);
-	SDL_Texture *texture = SDL_CreateTextureFromSurface(ctx->renderer, surface);
-	if (surface) {
-		SDL_RenderCopy(ctx->renderer, texture, NULL, NULL);
-		SDL_DestroyTexture(texture);
-		SDL_FreeSurface(surface);
-		return true;
-	} else {
+static bool display_sdl_blit_buffer(struct display_t *display, const struct display_image_t *image) {
+	if ((image->width != display->width) || (image->height != display->height) || (image->bits_per_pixel != 32)) {
+		return false;
+	}
+	return display_sdl_update_rect(display, image, &(const SDL_Rect){ .x = 0, .y = 0, .w = image->width, .h = image->height });
+}
+
+static bool display_sdl_blit_rects(struct display_t *display, const struct display_image_t *image, const struct display_rect_t *rects, unsigned int rect_count) {
+	if (image->bits_per_pixel != 32) {
 		return false;
 	}
+	for (unsigned int i = 0; i < rect_count; i++) {
+		const SDL_Rect rect = {
+			.x = rects[i].x,
+			.y = rects[i].y,
+			.w = rects[i].width,
+			.h = rects[i].height,
+		};
+		if (!display_sdl_update_rect(display, image, &rect)) {
+			return false;
+		}
+	}
+	return true;
 }
 
 const struct display_calltable_t display_sdl_calltable = {
 	.init = display_sdl_init,
 	.free = display_sdl_free,
+	.release = display_sdl_release,
 	.fill = display_sdl_fill,
 	.commit = display_sdl_commit,
 	.put_pixel = display_sdl_put_pixel,
 	.get_ctx_size = display_sdl_get_ctx_size,
 	.blit_buffer = display_sdl_blit_buffer,
+	.blit_rects = display_sdl_blit_rects,
 };
@@ -29,12 +29,15 @@
 
 struct display_sdl_ctx_t {
 	SDL_Window *window;
-	SDL_Surface *surface;
 	SDL_Renderer *renderer;
+	SDL_Texture *texture;
+	bool vsync;
+	bool renderer_failed;
 };
 
 struct display_sdl_init_t {
 	unsigned int width, height;
+	bool vsync;
 };
 
 extern const struct display_calltable_t display_sdl_calltable;
@@ -0,0 +1,242 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include "eventloop.h"
+
+struct eventloop_t *eventloop_init(void) {
+	struct eventloop_t *eventloop = calloc(sizeof(struct eventloop_t), 1);
+	if (!eventloop) {
+		perror("calloc");
+		return NULL;
+	}
+	eventloop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (eventloop->epoll_fd == -1) {
+		perror("epoll_create1");
+		free(eventloop);
+		return NULL;
+	}
+	return eventloop;
+}
+
+static struct eventloop_source_t *eventloop_add_source(struct eventloop_t *eventloop, enum eventloop_source_type_t type, int fd, uint32_t events, eventloop_cb_t callback, void *ctx) {
+	struct eventloop_source_t *source = calloc(sizeof(struct eventloop_source_t), 1);
+	if (!source) {
+		perror("calloc");
+		return NULL;
+	}
+	*source = (struct eventloop_source_t) {
+		.eventloop = eventloop,
+		.type = type,
+		.fd = fd,
+		.callback = callback,
+		.ctx = ctx,
+	};
+
+	struct epoll_event event = {
+		.events = events,
+		.data.ptr = source,
+	};
+	if (epoll_ctl(eventloop->epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+		perror("epoll_ctl");
+		free(source);
+		return NULL;
+	}
+	return source;
+}
+
+/* The file descriptor stays owned by the caller and has to outlive the
+ * source */
+struct eventloop_source_t *eventloop_add_fd(struct eventloop_t *eventloop, int fd, uint32_t events, eventloop_cb_t callback, void *ctx) {
+	return eventloop_add_source(eventloop, EVENTLOOP_FD, fd, events, callback, ctx);
+}
+
+bool eventloop_modify_fd(struct eventloop_source_t *source, uint32_t events) {
+	struct epoll_event event = {
+		.events = events,
+		.data.ptr = source,
+	};
+	if (epoll_ctl(source->eventloop->epoll_fd, EPOLL_CTL_MOD, source->fd, &event) == -1) {
+		perror("epoll_ctl");
+		return false;
+	}
+	return true;
+}
+
+static struct eventloop_source_t *eventloop_add_owned_fd(struct eventloop_t *eventloop, enum eventloop_source_type_t type, int fd, eventloop_cb_t callback, void *ctx) {
+	struct eventloop_source_t *source = eventloop_add_source(eventloop, type, fd, EPOLLIN, callback, ctx);
+	if (!source) {
+		close(fd);
+	}
+	return source;
+}
+
+/* Timers start out disarmed */
+struct eventloop_source_t *eventloop_add_timer(struct eventloop_t *eventloop, eventloop_cb_t callback, void *ctx) {
+	int fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (fd == -1) {
+		perror("timerfd_create");
+		return NULL;
+	}
+	return eventloop_add_owned_fd(eventloop, EVENTLOOP_TIMER, fd, callback, ctx);
+}
+
+/* Fires once at the given wall clock time, as returned by get_timespec_now().
+ * Rearming replaces the previous deadline, NULL disarms. */
+bool eventloop_timer_arm(struct eventloop_source_t *timer, const struct timespec *abstime) {
+	struct itimerspec value = { 0 };
+	if (abstime) {
+		value.it_value = *abstime;
+		if (!value.it_value.tv_sec && !value.it_value.tv_nsec) {
+			/* All zero would disarm instead */
+			value.it_value.tv_nsec = 1;
+		}
+	}
+	if (timerfd_settime(timer->fd, TFD_TIMER_ABSTIME, &value, NULL) == -1) {
+		perror("timerfd_settime");
+		return false;
+	}
+	return true;
+}
+
+/* Lets other threads interrupt the loop; the callback runs on the loop
+ * thread, once for any number of wakeups in between */
+struct eventloop_source_t *eventloop_add_wakeup(struct eventloop_t *eventloop, eventloop_cb_t callback, void *ctx) {
+	int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (fd == -1) {
+		perror("eventfd");
+		return NULL;
+	}
+	return eventloop_add_owned_fd(eventloop, EVENTLOOP_WAKEUP, fd, callback, ctx);
+}
+
+void eventloop_wakeup(struct eventloop_source_t *wakeup) {
+	const uint64_t increment = 1;
+	if ((write(wakeup->fd, &increment, sizeof(increment)) == -1) && (errno != EAGAIN)) {
+		perror("write");
+	}
+}
+
+/* The signals are blocked for the calling thread and every thread it creates
+ * afterwards, so this needs to be called before any other thread is started.
+ * The callback reads the signals with eventloop_read_signal(). */
+struct eventloop_source_t *eventloop_add_signals(struct eventloop_t *eventloop, const sigset_t *signals, eventloop_cb_t callback, void *ctx) {
+	int result = pthread_sigmask(SIG_BLOCK, signals, NULL);
+	if (result) {
+		fprintf(stderr, "pthread_sigmask: error %d\n", result);
+		return NULL;
+	}
+	int fd = signalfd(-1, signals, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (fd == -1) {
+		perror("signalfd");
+		return NULL;
+	}
+	return eventloop_add_owned_fd(eventloop, EVENTLOOP_SIGNALS, fd, callback, ctx);
+}
+
+/* Returns the next pending signal number or 0 if there is none */
+int eventloop_read_signal(struct eventloop_source_t *signals) {
+	struct signalfd_siginfo siginfo;
+	if (read(signals->fd, &siginfo, sizeof(siginfo)) != sizeof(siginfo)) {
+		return 0;
+	}
+	return siginfo.ssi_signo;
+}
+
+/* May be called from within any callback, including the source's own */
+void eventloop_remove(struct eventloop_source_t *source) {
+	if (!source) {
+		return;
+	}
+	struct eventloop_t *eventloop = source->eventloop;
+	if (epoll_ctl(eventloop->epoll_fd, EPOLL_CTL_DEL, source->fd, NULL) == -1) {
+		perror("epoll_ctl");
+	}
+	if (source->type != EVENTLOOP_FD) {
+		close(source->fd);
+	}
+	source->removed = true;
+	if (eventloop->dispatching) {
+		/* Might still be among the events currently being dispatched */
+		source->next_removed = eventloop->removed;
+		eventloop->removed = source;
+	} else {
+		free(source);
+	}
+}
+
+static void eventloop_drain(struct eventloop_source_t *source) {
+	uint64_t count;
+	if ((read(source->fd, &count, sizeof(count)) == -1) && (errno != EAGAIN)) {
+		perror("read");
+	}
+}
+
+/* Waits until at least one source is ready and runs the callbacks of all that
+ * are. Returns false if waiting failed. */
+bool eventloop_dispatch(struct eventloop_t *eventloop) {
+	struct epoll_event events[EVENTLOOP_MAX_EVENTS];
+	int count = epoll_wait(eventloop->epoll_fd, events, EVENTLOOP_MAX_EVENTS, -1);
+	if (count == -1) {
+		if (errno == EINTR) {
+			return true;
+		}
+		perror("epoll_wait");
+		return false;
+	}
+
+	eventloop->dispatching = true;
+	for (int i = 0; i < count; i++) {
+		struct eventloop_source_t *source = (struct eventloop_source_t*)events[i].data.ptr;
+		if (source->removed) {
+			continue;
+		}
+		if ((source->type == EVENTLOOP_TIMER) || (source->type == EVENTLOOP_WAKEUP)) {
+			eventloop_drain(source);
+		}
+		source->callback(source, events[i].events, source->ctx);
+	}
+	eventloop->dispatching = false;
+
+	while (eventloop->removed) {
+		struct eventloop_source_t *next = eventloop->removed->next_removed;
+		free(eventloop->removed);
+		eventloop->removed = next;
+	}
+	return true;
+}
+
+/* All sources need to have been removed by their owners */
+void eventloop_free(struct eventloop_t *eventloop) {
+	if (!eventloop) {
+		return;
+	}
+	close(eventloop->epoll_fd);
+	free(eventloop);
+}
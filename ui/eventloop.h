@@ -0,0 +1,80 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#ifndef __EVENTLOOP_H__
+#define __EVENTLOOP_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/epoll.h>
+
+enum eventloop_source_type_t {
+	EVENTLOOP_FD,
+	EVENTLOOP_TIMER,
+	EVENTLOOP_WAKEUP,
+	EVENTLOOP_SIGNALS,
+};
+
+struct eventloop_source_t;
+typedef void (*eventloop_cb_t)(struct eventloop_source_t *source, uint32_t events, void *ctx);
+
+/* Something the loop waits for: a file descriptor owned by the caller or a
+ * timerfd, eventfd or signalfd owned by the loop itself. */
+struct eventloop_source_t {
+	struct eventloop_t *eventloop;
+	enum eventloop_source_type_t type;
+	int fd;
+	eventloop_cb_t callback;
+	void *ctx;
+	bool removed;
+	struct eventloop_source_t *next_removed;
+};
+
+/* Multiplexes all sources on a single thread with epoll. Callbacks are run
+ * from eventloop_dispatch() on that thread; only eventloop_wakeup() may be
+ * called from elsewhere. */
+struct eventloop_t {
+	int epoll_fd;
+	bool dispatching;
+	struct eventloop_source_t *removed;
+};
+
+#define EVENTLOOP_MAX_EVENTS		16
+
+/*************** AUTO GENERATED SECTION FOLLOWS ***************/
+struct eventloop_t *eventloop_init(void);
+struct eventloop_source_t *eventloop_add_fd(struct eventloop_t *eventloop, int fd, uint32_t events, eventloop_cb_t callback, void *ctx);
+bool eventloop_modify_fd(struct eventloop_source_t *source, uint32_t events);
+struct eventloop_source_t *eventloop_add_timer(struct eventloop_t *eventloop, eventloop_cb_t callback, void *ctx);
+bool eventloop_timer_arm(struct eventloop_source_t *timer, const struct timespec *abstime);
+struct eventloop_source_t *eventloop_add_wakeup(struct eventloop_t *eventloop, eventloop_cb_t callback, void *ctx);
+void eventloop_wakeup(struct eventloop_source_t *wakeup);
+struct eventloop_source_t *eventloop_add_signals(struct eventloop_t *eventloop, const sigset_t *signals, eventloop_cb_t callback, void *ctx);
+int eventloop_read_signal(struct eventloop_source_t *signals);
+void eventloop_remove(struct eventloop_source_t *source);
+bool eventloop_dispatch(struct eventloop_t *eventloop);
+void eventloop_free(struct eventloop_t *eventloop);
+/***************  AUTO GENERATED SECTION ENDS   ***************/
+
+#endif
@@ -0,0 +1,189 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#include <stdio.h>
+#include <pthread.h>
+#include "framesched.h"
+#include "tools.h"
+
+static int timespec_cmp(const struct timespec *a, const struct timespec *b) {
+	if (a->tv_sec != b->tv_sec) {
+		return (a->tv_sec < b->tv_sec) ? -1 : 1;
+	}
+	if (a->tv_nsec != b->tv_nsec) {
+		return (a->tv_nsec < b->tv_nsec) ? -1 : 1;
+	}
+	return 0;
+}
+
+static struct timespec timespec_offset(const struct timespec *base, unsigned int offset_milliseconds) {
+	struct timespec result = *base;
+	add_timespec_offset(&result, offset_milliseconds);
+	return result;
+}
+
+static const struct timespec *timespec_max(const struct timespec *a, const struct timespec *b) {
+	return (timespec_cmp(a, b) >= 0) ? a : b;
+}
+
+static void framesched_interrupt(struct framesched_t *sched) {
+	isleep_interrupt(&sched->isleep);
+	if (sched->wakeup) {
+		sched->wakeup(sched->wakeup_ctx);
+	}
+}
+
+/* For callers that do not block in framesched_wait() but poll instead, this
+ * is called whenever the due time may have moved */
+void framesched_set_wakeup(struct framesched_t *sched, void (*wakeup)(void *ctx), void *ctx) {
+	pthread_mutex_lock(&sched->isleep.mutex);
+	sched->wakeup = wakeup;
+	sched->wakeup_ctx = ctx;
+	pthread_mutex_unlock(&sched->isleep.mutex);
+}
+
+void framesched_set_max_rate(struct framesched_t *sched, unsigned int max_fps) {
+	pthread_mutex_lock(&sched->isleep.mutex);
+	sched->min_frame_interval_ms = max_fps ? (1000 / max_fps) : 0;
+	pthread_mutex_unlock(&sched->isleep.mutex);
+	framesched_interrupt(sched);
+}
+
+void framesched_mark_dirty(struct framesched_t *sched) {
+	pthread_mutex_lock(&sched->isleep.mutex);
+	sched->dirty_marks++;
+	if (!sched->dirty) {
+		sched->dirty = true;
+		get_timespec_now(&sched->dirty_since);
+	}
+	pthread_mutex_unlock(&sched->isleep.mutex);
+	framesched_interrupt(sched);
+}
+
+/* Keep producing frames at the given rate (still capped by the maximum frame
+ * rate) for the given duration, regardless of whether anything is dirty.
+ * Overlapping requests extend the animation and use the faster rate. */
+void framesched_request_animation(struct framesched_t *sched, unsigned int fps, unsigned int duration_milliseconds) {
+	if (!fps) {
+		return;
+	}
+	struct timespec until;
+	get_abs_timespec_offset(&until, duration_milliseconds);
+
+	pthread_mutex_lock(&sched->isleep.mutex);
+	const unsigned int interval_ms = 1000 / fps;
+	if (!sched->animating) {
+		sched->animating = true;
+		sched->animation_interval_ms = interval_ms;
+		sched->animation_until = until;
+	} else {
+		if (interval_ms < sched->animation_interval_ms) {
+			sched->animation_interval_ms = interval_ms;
+		}
+		sched->animation_until = *timespec_max(&sched->animation_until, &until);
+	}
+	pthread_mutex_unlock(&sched->isleep.mutex);
+	framesched_interrupt(sched);
+}
+
+void framesched_stop(struct framesched_t *sched) {
+	pthread_mutex_lock(&sched->isleep.mutex);
+	sched->stopped = true;
+	pthread_mutex_unlock(&sched->isleep.mutex);
+	framesched_interrupt(sched);
+}
+
+/* Must be called with the mutex held. Returns true if a frame is due now and
+ * accounts for it. Otherwise, *have_due tells whether a frame will become due
+ * without further changes and *due when that is. */
+static bool framesched_check(struct framesched_t *sched, struct timespec *due, bool *have_due) {
+	struct timespec now_ts;
+	get_timespec_now(&now_ts);
+
+	if (sched->animating && (timespec_cmp(&now_ts, &sched->animation_until) > 0)) {
+		sched->animating = false;
+	}
+
+	const struct timespec earliest = timespec_offset(&sched->last_frame, sched->min_frame_interval_ms);
+	*have_due = false;
+	if (sched->dirty) {
+		/* Wait a few milliseconds after the first change so that
+		 * messages arriving back to back end up in one frame */
+		const struct timespec settled = timespec_offset(&sched->dirty_since, sched->coalesce_ms);
+		*due = *timespec_max(&earliest, &settled);
+		*have_due = true;
+	}
+	if (sched->animating) {
+		const struct timespec next_animation_frame = timespec_offset(&sched->last_frame, sched->animation_interval_ms);
+		const struct timespec *animation_due = timespec_max(&earliest, &next_animation_frame);
+		if (!*have_due || (timespec_cmp(animation_due, due) < 0)) {
+			*due = *animation_due;
+			*have_due = true;
+		}
+	}
+
+	if (*have_due && (timespec_cmp(&now_ts, due) >= 0)) {
+		sched->dirty = false;
+		sched->last_frame = now_ts;
+		sched->frames++;
+		return true;
+	}
+	return false;
+}
+
+/* Non-blocking counterpart of framesched_wait() for event loops: returns true
+ * if a frame is to be rendered now. Otherwise, the next frame is due at *due
+ * if *have_due is set, or only once something changes. */
+bool framesched_poll(struct framesched_t *sched, struct timespec *due, bool *have_due) {
+	bool render = false;
+	*have_due = false;
+	pthread_mutex_lock(&sched->isleep.mutex);
+	if (!sched->stopped) {
+		render = framesched_check(sched, due, have_due);
+	}
+	pthread_mutex_unlock(&sched->isleep.mutex);
+	return render;
+}
+
+/* Blocks until the next frame is due. Returns false once the scheduler has
+ * been stopped. With nothing dirty and no animation running this sleeps
+ * without any timeout at all. */
+bool framesched_wait(struct framesched_t *sched) {
+	bool render = false;
+	pthread_mutex_lock(&sched->isleep.mutex);
+	while (!sched->stopped) {
+		struct timespec due;
+		bool have_due;
+		if (framesched_check(sched, &due, &have_due)) {
+			render = true;
+			break;
+		}
+
+		if (have_due) {
+			pthread_cond_timedwait(&sched->isleep.cond, &sched->isleep.mutex, &due);
+		} else {
+			pthread_cond_wait(&sched->isleep.cond, &sched->isleep.mutex);
+		}
+	}
+	pthread_mutex_unlock(&sched->isleep.mutex);
+	return render;
+}
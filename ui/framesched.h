@@ -0,0 +1,69 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#ifndef __FRAMESCHED_H__
+#define __FRAMESCHED_H__
+
+#include <stdbool.h>
+#include <time.h>
+#include "isleep.h"
+
+#define FRAMESCHED_COALESCE_MILLISECONDS		5
+
+/* Decides when the main loop has to render. Frames are only produced when
+ * someone marked the state dirty or an animation is running; everything that
+ * is marked dirty while a frame is pending is merged into that frame. */
+struct framesched_t {
+	struct isleep_t isleep;
+	unsigned int min_frame_interval_ms;
+	unsigned int coalesce_ms;
+	bool stopped;
+	bool dirty;
+	struct timespec dirty_since;
+	struct timespec last_frame;
+	bool animating;
+	unsigned int animation_interval_ms;
+	struct timespec animation_until;
+	unsigned long frames;
+	unsigned long dirty_marks;
+	void (*wakeup)(void *ctx);
+	void *wakeup_ctx;
+};
+
+#define FRAMESCHED_INITIALIZER(max_fps)		{ \
+	.isleep = ISLEEP_INITIALIZER, \
+	.min_frame_interval_ms = 1000 / (max_fps), \
+	.coalesce_ms = FRAMESCHED_COALESCE_MILLISECONDS, \
+	.dirty = true, \
+}
+
+/*************** AUTO GENERATED SECTION FOLLOWS ***************/
+void framesched_set_wakeup(struct framesched_t *sched, void (*wakeup)(void *ctx), void *ctx);
+void framesched_set_max_rate(struct framesched_t *sched, unsigned int max_fps);
+void framesched_mark_dirty(struct framesched_t *sched);
+void framesched_request_animation(struct framesched_t *sched, unsigned int fps, unsigned int duration_milliseconds);
+void framesched_stop(struct framesched_t *sched);
+bool framesched_poll(struct framesched_t *sched, struct timespec *due, bool *have_due);
+bool framesched_wait(struct framesched_t *sched);
+/***************  AUTO GENERATED SECTION ENDS   ***************/
+
+#endif
@@ -34,20 +34,6 @@
 #include "jsondom.h"
 #include "tools.h"
 
-static bool truncate_crlf(char *string) {
-	int length = strlen(string);
-	bool truncated = false;
-	if (length && (string[length - 1] == '\n')) {
-		truncated = true;
-		string[--length] = 0;
-	}
-	if (length && (string[length - 1] == '\r')) {
-		truncated = true;
-		string[--length] = 0;
-	}
-	return truncated;
-}
-
 static void historian_change_state(struct historian_t *historian, enum historian_state_t new_state) {
 	if (new_state != historian->connection_state) {
 		if (historian->event_callback) {
@@ -62,158 +48,545 @@ static void historian_change_state(struct historian_t *historian, enum historian
 }
 
 
-static void handle_historian_connection(struct historian_t *historian) {
-	while (historian->running) {
-		char line_buffer[1024 * 16];
-		if (!fgets(line_buffer, sizeof(line_buffer), historian->f_read)) {
-			/* EOF */
-			break;
+/* Must be called with the mutex held. Requests are found by their body only
+ * once they have been sent; those still queued are found in the queue.
+ * Requests that have timed out are treated as if they had never been sent. */
+static struct historian_request_t *historian_find_request(struct historian_t *historian, const char *body, unsigned int request_id) {
+	const double now_ts = now();
+	for (unsigned int i = 0; i < HISTORIAN_MAX_PENDING_REQUESTS; i++) {
+		struct historian_request_t *request = &historian->pending_requests[i];
+		if (!request->id || (request->sent_at && (now_ts - request->sent_at > HISTORIAN_REQUEST_TIMEOUT_SECONDS))) {
+			continue;
 		}
+		if ((body && request->sent_at && !strcmp(request->body, body)) || (request->id == request_id)) {
+			return request;
+		}
+	}
+	return NULL;
+}
 
-		if (!truncate_crlf(line_buffer)) {
-			/* Either not complete line or empty line from the beginning */
-			fprintf(stderr, "Received improper command line, severing connection.\n");
-			historian->running = false;
+static void historian_release_request(struct historian_request_t *request) {
+	free(request->body);
+	*request = (struct historian_request_t) { 0 };
+}
+
+/* Must be called with the mutex held, takes ownership of the body. If all
+ * slots are taken, the oldest request is forgotten; ones that have not been
+ * sent go first. A response to a forgotten request is still handed on. */
+static void historian_track_request(struct historian_t *historian, unsigned int request_id, char *body) {
+	struct historian_request_t *slot = &historian->pending_requests[0];
+	for (unsigned int i = 0; i < HISTORIAN_MAX_PENDING_REQUESTS; i++) {
+		struct historian_request_t *request = &historian->pending_requests[i];
+		if (!request->id) {
+			slot = request;
 			break;
 		}
+		if (request->sent_at < slot->sent_at) {
+			slot = request;
+		}
+	}
+	historian_release_request(slot);
+	*slot = (struct historian_request_t) {
+		.id = request_id,
+		.body = body,
+	};
+}
 
-		/* Now try to parse the JSON message that we received */
-		struct jsondom_t *json = jsondom_parse(line_buffer);
-		if (!json) {
-			fprintf(stderr, "Failed to parse server JSON, severing connection.\n");
-			fprintf(stderr, "RX: '%s'\n", line_buffer);
-			FILE *x = fopen("out.json", "w");
-			fwrite(line_buffer, 1, strlen(line_buffer), x);
-			fclose(x);
-			historian->running = false;
-			break;
+/* Must be called with the mutex held. The timeout only starts once the
+ * request has actually been written to the historian. */
+static void historian_consume_sent(struct historian_t *historian, size_t length) {
+	const unsigned int request_id = cmdqueue_consume(historian->tx_queue, length);
+	if (request_id) {
+		struct historian_request_t *request = historian_find_request(historian, NULL, request_id);
+		if (request) {
+			request->sent_at = now();
+		}
+	}
+}
+
+/* Must be called with the mutex held. Requests that are still queued are
+ * sent again after reconnecting and stay tracked unless all are forgotten. */
+static void historian_forget_requests(struct historian_t *historian, bool sent_only) {
+	for (unsigned int i = 0; i < HISTORIAN_MAX_PENDING_REQUESTS; i++) {
+		if (!sent_only || historian->pending_requests[i].sent_at) {
+			historian_release_request(&historian->pending_requests[i]);
 		}
+	}
+}
 
-		/* Event recived */
-		if (historian->event_callback) {
-			historian->event_callback(EVENT_HISTORIAN_MESSAGE, &((struct ui_event_historian_msg_t){ .historian = historian, .json = json }), historian->event_callback_ctx);
+/* Returns false if the connection needs to be severed */
+static bool handle_historian_message(struct historian_t *historian, char *line, size_t length) {
+	if (!length) {
+		return true;
+	}
+
+	/* The message is parsed right where it was received */
+	struct jsondom_t *json = jsondom_parse_length(line, length);
+	if (!json) {
+		fprintf(stderr, "Failed to parse server JSON, severing connection.\n");
+		fprintf(stderr, "RX: '%s'\n", line);
+		return false;
+	}
+
+	/* A response to a request that is no longer in flight is still handed
+	 * on, its content may be useful nonetheless */
+	const unsigned int request_id = jsondom_get_dict_int(json, "id");
+	if (request_id) {
+		pthread_mutex_lock(&historian->mutex);
+		struct historian_request_t *request = historian_find_request(historian, NULL, request_id);
+		if (request) {
+			historian_release_request(request);
 		}
-		jsondom_free(json);
+		pthread_mutex_unlock(&historian->mutex);
 	}
+
+	/* Event recived */
+	if (historian->event_callback) {
+		historian->event_callback(EVENT_HISTORIAN_MESSAGE, &((struct ui_event_historian_msg_t){ .historian = historian, .json = json, .request_id = request_id }), historian->event_callback_ctx);
+	}
+	jsondom_free(json);
+	return true;
+}
+
+/* Looks for the "msgtype" key without parsing the message. Quotes inside
+ * strings are escaped, so any match is either that key or a string value of
+ * the same text, which is not followed by a colon. */
+static bool historian_message_is_status(const char *line) {
+	for (const char *key = strstr(line, "\"msgtype\""); key; key = strstr(key + 1, "\"msgtype\"")) {
+		const char *value = key + strlen("\"msgtype\"");
+		value += strspn(value, " \t");
+		if (*value != ':') {
+			continue;
+		}
+		value++;
+		value += strspn(value, " \t");
+		return !strncmp(value, "\"status\"", strlen("\"status\""));
+	}
+	return false;
+}
+
+/* Reads once and handles all messages completed by that. Returns false if the
+ * connection was closed or needs to be severed. */
+static bool historian_receive(struct historian_t *historian) {
+	ssize_t length = linebuf_fill(historian->rx_buffer, historian->fd);
+	if (length == 0) {
+		/* EOF */
+		return false;
+	} else if (length == -1) {
+		if (errno == EMSGSIZE) {
+			fprintf(stderr, "Received message exceeds %u bytes, severing connection.\n", HISTORIAN_MAX_MESSAGE_SIZE);
+		} else {
+			perror("read");
+		}
+		return false;
+	}
+
+	/* One read may complete any number of messages, i.e., everything that
+	 * was waiting in the socket buffer. A status message immediately
+	 * followed by another one is outdated before it could ever be shown and
+	 * is skipped without being parsed. Status deltas build on each other
+	 * and never count as status messages here. */
+	size_t line_length, next_length;
+	char *line = linebuf_next_line(historian->rx_buffer, &line_length);
+	while (line) {
+		char *next = linebuf_next_line(historian->rx_buffer, &next_length);
+		if (next && historian_message_is_status(line) && historian_message_is_status(next)) {
+			pthread_mutex_lock(&historian->mutex);
+			historian->skipped_status_messages++;
+			pthread_mutex_unlock(&historian->mutex);
+		} else if (!handle_historian_message(historian, line, line_length)) {
+			return false;
+		}
+		line = next;
+		line_length = next_length;
+	}
+	return true;
+}
+
+static bool historian_open(struct historian_t *historian) {
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd == -1) {
+		perror("socket");
+		return false;
+	}
+
+	struct sockaddr_un destination = {
+	   .sun_family = AF_UNIX,
+	};
+	strncpy(destination.sun_path, historian->unix_socket, UNIX_PATH_MAX - 1);
+
+	if (connect(fd, (struct sockaddr*)&destination, sizeof(destination)) == -1) {
+		perror("connect");
+		close(fd);
+		return false;
+	}
+
+	pthread_mutex_lock(&historian->mutex);
+	historian->fd = fd;
+	historian->generation++;
+	pthread_cond_broadcast(&historian->send_cond);
+	pthread_mutex_unlock(&historian->mutex);
+
+	linebuf_reset(historian->rx_buffer);
+	return true;
+}
+
+static void historian_close(struct historian_t *historian) {
+	pthread_mutex_lock(&historian->mutex);
+	shutdown(historian->fd, SHUT_RDWR);
+	close(historian->fd);
+	historian->fd = -1;
+	historian->generation++;
+	pthread_cond_broadcast(&historian->send_cond);
+
+	/* Responses to anything in flight will never arrive */
+	historian_forget_requests(historian, true);
+	pthread_mutex_unlock(&historian->mutex);
 }
 
 static void* historian_connection_thread_fnc(void *vhistorian) {
 	struct historian_t *historian = (struct historian_t*)vhistorian;
 	while (historian->running) {
 		/* Try to establish a connection */
-		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
-		if (fd == -1) {
-			perror("socket");
-			sleep(1);
+		if (!historian_open(historian)) {
+			sleep(HISTORIAN_RECONNECT_SECONDS);
 			continue;
 		}
 
-		struct sockaddr_un destination = {
-		   .sun_family = AF_UNIX,
-		};
-		strncpy(destination.sun_path, historian->unix_socket, UNIX_PATH_MAX - 1);
+		historian_change_state(historian, CONNECTED);
+		while (historian->running && historian_receive(historian));
+		historian_close(historian);
+		historian_change_state(historian, UNCONNECTED);
+	}
+	return NULL;
+}
 
-		if (connect(fd, (struct sockaddr*)&destination, sizeof(destination)) == -1) {
-			perror("connect");
-			sleep(3);
-			continue;
+/* Drains the command queue over a descriptor of its own, so that a stalled
+ * historian only ever blocks this thread. Whenever the connection changes,
+ * a partially sent command is sent again as a whole. */
+static void* historian_send_thread_fnc(void *vhistorian) {
+	struct historian_t *historian = (struct historian_t*)vhistorian;
+	int write_fd = -1;
+	unsigned int generation = 0;
+	pthread_mutex_lock(&historian->mutex);
+	while (historian->running) {
+		if (generation != historian->generation) {
+			if (write_fd != -1) {
+				close(write_fd);
+			}
+			write_fd = (historian->fd == -1) ? -1 : dup(historian->fd);
+			generation = historian->generation;
+			cmdqueue_rewind(historian->tx_queue);
 		}
 
-		int dupfd = dup(fd);
-		if (dupfd == -1) {
-			perror("dup");
-			close(fd);
-			sleep(3);
+		const char *data;
+		size_t length;
+		if ((write_fd == -1) || !cmdqueue_peek(historian->tx_queue, &data, &length)) {
+			pthread_cond_wait(&historian->send_cond, &historian->mutex);
 			continue;
 		}
 
-		pthread_mutex_lock(&historian->f_mutex);
-		historian->f_read = fdopen(fd, "r");
-		if (!historian->f_read) {
-			perror("fdopen");
-			pthread_mutex_unlock(&historian->f_mutex);
-			close(fd);
-			close(dupfd);
-			sleep(3);
-			continue;
+		pthread_mutex_unlock(&historian->mutex);
+		ssize_t sent = send(write_fd, data, length, MSG_NOSIGNAL);
+		pthread_mutex_lock(&historian->mutex);
+		if (sent > 0) {
+			historian_consume_sent(historian, sent);
+		} else if ((sent == -1) && (errno != EINTR)) {
+			/* Connection is gone, wait for the next one */
+			close(write_fd);
+			write_fd = -1;
 		}
-		historian->f_write = fdopen(dupfd, "w");
-		if (!historian->f_write) {
-			perror("fdopen");
-			fclose(historian->f_read);
-			historian->f_read = NULL;
-			pthread_mutex_unlock(&historian->f_mutex);
-			close(dupfd);
-			sleep(3);
+	}
+	pthread_mutex_unlock(&historian->mutex);
+	if (write_fd != -1) {
+		close(write_fd);
+	}
+	return NULL;
+}
+
+static void historian_eventloop_connect(struct historian_t *historian);
+
+/* Sends as much as the socket takes without blocking and only asks for
+ * writability while something is left over */
+static void historian_eventloop_send(struct historian_t *historian) {
+	if (!historian->read_source) {
+		/* Replayed once connected */
+		return;
+	}
+
+	bool would_block = false;
+	const char *data;
+	size_t length;
+	pthread_mutex_lock(&historian->mutex);
+	while (cmdqueue_peek(historian->tx_queue, &data, &length)) {
+		pthread_mutex_unlock(&historian->mutex);
+		ssize_t sent = send(historian->fd, data, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+		pthread_mutex_lock(&historian->mutex);
+		if (sent > 0) {
+			historian_consume_sent(historian, sent);
+		} else if ((sent == -1) && (errno == EINTR)) {
 			continue;
+		} else {
+			/* Any other error is noticed by the receiving side */
+			would_block = (sent == -1) && ((errno == EAGAIN) || (errno == EWOULDBLOCK));
+			break;
 		}
-		pthread_mutex_unlock(&historian->f_mutex);
+	}
+	pthread_mutex_unlock(&historian->mutex);
 
-		historian_change_state(historian, CONNECTED);
-		handle_historian_connection(historian);
-		shutdown(fd, SHUT_RDWR);
+	if (would_block != historian->want_writable) {
+		if (eventloop_modify_fd(historian->read_source, EPOLLIN | (would_block ? EPOLLOUT : 0))) {
+			historian->want_writable = would_block;
+		}
+	}
+}
 
-		pthread_mutex_lock(&historian->f_mutex);
-		fclose(historian->f_read);
-		fclose(historian->f_write);
-		historian->f_read = NULL;
-		historian->f_write = NULL;
-		pthread_mutex_unlock(&historian->f_mutex);
+static void historian_eventloop_send_wakeup(struct eventloop_source_t *source, uint32_t events, void *vhistorian) {
+	historian_eventloop_send((struct historian_t*)vhistorian);
+}
 
+static void historian_eventloop_readable(struct eventloop_source_t *source, uint32_t events, void *vhistorian) {
+	struct historian_t *historian = (struct historian_t*)vhistorian;
+	if (events & EPOLLOUT) {
+		historian_eventloop_send(historian);
+	}
+	if (!(events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+		return;
+	}
+	if (!historian_receive(historian)) {
+		eventloop_remove(historian->read_source);
+		historian->read_source = NULL;
+		historian_close(historian);
 		historian_change_state(historian, UNCONNECTED);
+		historian_eventloop_connect(historian);
 	}
-	return NULL;
 }
 
-struct historian_t *historian_connect(const char *unix_socket, ui_event_cb_t historian_event_cb, void *callback_ctx) {
+static void historian_eventloop_reconnect(struct eventloop_source_t *source, uint32_t events, void *vhistorian) {
+	historian_eventloop_connect((struct historian_t*)vhistorian);
+}
+
+/* Instead of sleeping like the connection thread, a failed attempt is retried
+ * once the reconnect timer fires */
+static void historian_eventloop_connect(struct historian_t *historian) {
+	if (historian_open(historian)) {
+		historian->read_source = eventloop_add_fd(historian->eventloop, historian->fd, EPOLLIN, historian_eventloop_readable, historian);
+		if (historian->read_source) {
+			historian->want_writable = false;
+			pthread_mutex_lock(&historian->mutex);
+			cmdqueue_rewind(historian->tx_queue);
+			pthread_mutex_unlock(&historian->mutex);
+			historian_change_state(historian, CONNECTED);
+			historian_eventloop_send(historian);
+			return;
+		}
+		historian_close(historian);
+	}
+
+	struct timespec retry_at;
+	get_abs_timespec_offset(&retry_at, HISTORIAN_RECONNECT_SECONDS * 1000);
+	eventloop_timer_arm(historian->reconnect_timer, &retry_at);
+}
+
+/* Without an event loop, the connection is handled by a thread of its own */
+struct historian_t *historian_connect(const char *unix_socket, struct eventloop_t *eventloop, ui_event_cb_t historian_event_cb, void *callback_ctx) {
 	struct historian_t *historian = calloc(sizeof(struct historian_t), 1);
 	if (!historian) {
 		perror("calloc");
 		return NULL;
 	}
 
-	pthread_mutex_init(&historian->f_mutex, NULL);
+	historian->rx_buffer = linebuf_init(HISTORIAN_RECEIVE_BUFFER_SIZE, HISTORIAN_MAX_MESSAGE_SIZE);
+	if (!historian->rx_buffer) {
+		free(historian);
+		return NULL;
+	}
+
+	historian->tx_queue = cmdqueue_init(HISTORIAN_MAX_QUEUED_COMMANDS);
+	if (!historian->tx_queue) {
+		linebuf_free(historian->rx_buffer);
+		free(historian);
+		return NULL;
+	}
+
+	pthread_mutex_init(&historian->mutex, NULL);
+	pthread_cond_init(&historian->send_cond, NULL);
+	historian->fd = -1;
 	historian->connection_state = UNCONNECTED;
 	historian->unix_socket = unix_socket;
 	historian->event_callback = historian_event_cb;
 	historian->event_callback_ctx = callback_ctx;
 	historian->running = true;
-	if (pthread_create(&historian->connection_thread, NULL, historian_connection_thread_fnc, historian)) {
-		perror("pthread_create");
-		free(historian);
-		return NULL;
+	historian->eventloop = eventloop;
+	if (eventloop) {
+		historian->reconnect_timer = eventloop_add_timer(eventloop, historian_eventloop_reconnect, historian);
+		historian->send_wakeup = eventloop_add_wakeup(eventloop, historian_eventloop_send_wakeup, historian);
+		if (!historian->reconnect_timer || !historian->send_wakeup) {
+			historian_free(historian);
+			return NULL;
+		}
+		historian_eventloop_connect(historian);
+	} else {
+		if (pthread_create(&historian->send_thread, NULL, historian_send_thread_fnc, historian)) {
+			perror("pthread_create");
+			historian->running = false;
+			historian_free(historian);
+			return NULL;
+		}
+		historian->send_thread_running = true;
+		if (pthread_create(&historian->connection_thread, NULL, historian_connection_thread_fnc, historian)) {
+			perror("pthread_create");
+			historian_free(historian);
+			return NULL;
+		}
+		historian->connection_thread_running = true;
 	}
 
 	return historian;
 }
 
-void historian_command(struct historian_t *historian, const char *cmdname, const char *params, ...) {
-	char msgbuf[256];
-	if (!params) {
-		snprintf(msgbuf, sizeof(msgbuf), "{\"cmd\":\"%s\"}\n", cmdname);
-	} else {
-		unsigned int offset = 0;
-		if (offset < sizeof(msgbuf)) {
-			offset += snprintf(msgbuf + offset, sizeof(msgbuf) - offset, "{\"cmd\":\"%s\",", cmdname);
-		}
-		va_list ap;
-		va_start(ap, params);
-		if (offset < sizeof(msgbuf)) {
-			offset += vsnprintf(msgbuf + offset, sizeof(msgbuf) - offset, params, ap);
+/* Asking for any of these again before the first request went out makes no
+ * difference */
+static bool historian_command_is_idempotent(const char *cmdname) {
+	static const char *idempotent_commands[] = { "status", "playerinfo", NULL };
+	for (const char **command = idempotent_commands; *command; command++) {
+		if (!strcmp(cmdname, *command)) {
+			return true;
 		}
+	}
+	return false;
+}
+
+/* Request IDs are only included if non-zero */
+static char *historian_format_command(const char *cmdname, unsigned int request_id, const char *params, va_list ap, size_t *length) {
+	va_list ap_length;
+	va_copy(ap_length, ap);
+	const int params_length = params ? vsnprintf(NULL, 0, params, ap_length) : 0;
+	va_end(ap_length);
+	if (params_length < 0) {
+		return NULL;
+	}
+
+	const size_t size = strlen(cmdname) + params_length + 32;
+	char *message = malloc(size);
+	if (!message) {
+		perror("malloc");
+		return NULL;
+	}
+	int offset = snprintf(message, size, "{\"cmd\":\"%s\"", cmdname);
+	if (request_id) {
+		offset += snprintf(message + offset, size - offset, ",\"id\":%u", request_id);
+	}
+	if (params) {
+		offset += snprintf(message + offset, size - offset, ",");
+	}
+	if (params) {
+		offset += vsnprintf(message + offset, size - offset, params, ap);
+	}
+	offset += snprintf(message + offset, size - offset, "}\n");
+	*length = offset;
+	return message;
+}
+
+/* Must be called with the mutex held, takes ownership of the message and the
+ * key */
+static bool historian_enqueue(struct historian_t *historian, const char *cmdname, char *message, size_t length, char *key, unsigned int request_id) {
+	const unsigned long dropped = historian->tx_queue->dropped;
+	const bool queued = cmdqueue_push(historian->tx_queue, message, length, key, request_id, historian_command_is_idempotent(cmdname));
+	if (historian->tx_queue->dropped != dropped) {
+		fprintf(stderr, "Command queue full, discarding an older command in favor of %s.\n", cmdname);
+	}
+	pthread_cond_broadcast(&historian->send_cond);
+	return queued;
+}
+
+static void historian_wakeup_sender(struct historian_t *historian) {
+	if (historian->eventloop) {
+		eventloop_wakeup(historian->send_wakeup);
+	}
+}
+
+/* Never blocks on the connection: the command is queued and sent by the I/O
+ * side. While disconnected, commands are kept and sent after reconnecting. */
+void historian_command(struct historian_t *historian, const char *cmdname, const char *params, ...) {
+	va_list ap;
+	va_start(ap, params);
+	size_t length;
+	char *message = historian_format_command(cmdname, 0, params, ap, &length);
+	va_end(ap);
+	if (!message) {
+		return;
+	}
+
+	pthread_mutex_lock(&historian->mutex);
+	const bool queued = historian_enqueue(historian, cmdname, message, length, NULL, 0);
+	pthread_mutex_unlock(&historian->mutex);
+	if (queued) {
+		historian_wakeup_sender(historian);
+	}
+}
+
+/* Like historian_command(), but tags the command with a request ID that the
+ * historian returns in its response and tracks it until that arrives. An
+ * identical request that is still queued is not queued again, its answer will
+ * be current anyway. When deduplicating, the same goes for an identical
+ * request that has already been sent. In both cases, the ID of the earlier
+ * request is returned. Returns 0 if the request could not be queued. */
+unsigned int historian_request(struct historian_t *historian, bool deduplicate, const char *cmdname, const char *params, ...) {
+	va_list ap, ap_body;
+	va_start(ap, params);
+	va_copy(ap_body, ap);
+	size_t body_length;
+	char *body = historian_format_command(cmdname, 0, params, ap_body, &body_length);
+	va_end(ap_body);
+	if (!body) {
 		va_end(ap);
-		if (offset < sizeof(msgbuf)) {
-			offset += snprintf(msgbuf + offset, sizeof(msgbuf) - offset, "}\n");
-		}
+		return 0;
+	}
+
+	pthread_mutex_lock(&historian->mutex);
+	const struct historian_request_t *in_flight = deduplicate ? historian_find_request(historian, body, 0) : NULL;
+	const unsigned int earlier_request_id = in_flight ? in_flight->id : cmdqueue_find(historian->tx_queue, body);
+	if (earlier_request_id) {
+		pthread_mutex_unlock(&historian->mutex);
+		va_end(ap);
+		free(body);
+		return earlier_request_id;
+	}
+
+	unsigned int request_id = ++historian->last_request_id;
+	if (!request_id) {
+		request_id = ++historian->last_request_id;
+	}
+	size_t length;
+	char *message = historian_format_command(cmdname, request_id, params, ap, &length);
+	va_end(ap);
+	char *key = message ? strdup(body) : NULL;
+	if (message && !key) {
+		perror("strdup");
+		free(message);
+		message = NULL;
 	}
-	pthread_mutex_lock(&historian->f_mutex);
-	if (historian->f_write) {
-		fputs(msgbuf, historian->f_write);
-		fflush(historian->f_write);
+	if (message && historian_enqueue(historian, cmdname, message, length, key, request_id)) {
+		historian_track_request(historian, request_id, body);
+		body = NULL;
 	} else {
-		fprintf(stderr, "Command discarded, no write connection: %s", msgbuf);
+		request_id = 0;
 	}
-	pthread_mutex_unlock(&historian->f_mutex);
+	pthread_mutex_unlock(&historian->mutex);
+	free(body);
+
+	if (request_id) {
+		historian_wakeup_sender(historian);
+	}
+	return request_id;
+}
+
+unsigned long historian_get_skipped_status_messages(struct historian_t *historian) {
+	pthread_mutex_lock(&historian->mutex);
+	unsigned long skipped = historian->skipped_status_messages;
+	pthread_mutex_unlock(&historian->mutex);
+	return skipped;
 }
 
 void historian_simple_command(struct historian_t *historian, const char *cmdname) {
@@ -225,18 +598,38 @@ void historian_free(struct historian_t *historian) {
 		return;
 	}
 	historian->running = false;
-	pthread_mutex_lock(&historian->f_mutex);
-	if (historian->f_read) {
-		shutdown(fileno(historian->f_read), SHUT_RDWR);
+	if (historian->eventloop) {
+		eventloop_remove(historian->reconnect_timer);
+		eventloop_remove(historian->send_wakeup);
+		if (historian->read_source) {
+			eventloop_remove(historian->read_source);
+			historian_close(historian);
+		}
+	} else {
+		pthread_mutex_lock(&historian->mutex);
+		if (historian->fd != -1) {
+			shutdown(historian->fd, SHUT_RDWR);
+		}
+		pthread_cond_broadcast(&historian->send_cond);
+		pthread_mutex_unlock(&historian->mutex);
+		if (historian->connection_thread_running) {
+			pthread_join(historian->connection_thread, NULL);
+		}
+		if (historian->send_thread_running) {
+			pthread_join(historian->send_thread, NULL);
+		}
 	}
-	pthread_mutex_unlock(&historian->f_mutex);
-	pthread_join(historian->connection_thread, NULL);
+	historian_forget_requests(historian, false);
+	pthread_cond_destroy(&historian->send_cond);
+	pthread_mutex_destroy(&historian->mutex);
+	cmdqueue_free(historian->tx_queue);
+	linebuf_free(historian->rx_buffer);
 	free(historian);
 }
 
 #ifdef TEST_HISTORIAN
 
-// gcc -Wall -D_POSIX_C_SOURCE=200112L -D_XOPEN_SOURCE=500 -Wall -Wmissing-prototypes -Wstrict-prototypes -Werror=implicit-function-declaration -Werror=format -Wshadow -Wswitch -pthread -std=c11 -DTEST_HISTORIAN historian.c jsondom.c tools.c -o historian -ggdb3 -fsanitize=address -fsanitize=undefined -fsanitize=leak -fno-omit-frame-pointer -D_FORTITY_SOURCE=2 `pkg-config --cflags --libs yajl` && ./historian
+// gcc -Wall -D_POSIX_C_SOURCE=200112L -D_XOPEN_SOURCE=500 -Wall -Wmissing-prototypes -Wstrict-prototypes -Werror=implicit-function-declaration -Werror=format -Wshadow -Wswitch -pthread -std=c11 -DTEST_HISTORIAN historian.c jsondom.c linebuf.c cmdqueue.c eventloop.c tools.c -o historian -ggdb3 -fsanitize=address -fsanitize=undefined -fsanitize=leak -fno-omit-frame-pointer -D_FORTITY_SOURCE=2 `pkg-config --cflags --libs yajl` && ./historian
 
 static void event_callback(enum ui_eventtype_t event_type, void *event, void *ctx) {
 	if (event_type == EVENT_HISTORIAN_MESSAGE) {
@@ -254,7 +647,7 @@ static void event_callback(enum ui_eventtype_t event_type, void *event, void *ct
 }
 
 int main(void) {
-	struct historian_t *historian = historian_connect("../historian/unix_sock", event_callback, NULL);
+	struct historian_t *historian = historian_connect("../historian/unix_sock", NULL, event_callback, NULL);
 	for (int i = 0; i < 2; i++) {
 		historian_simple_command(historian, "status");
 	}
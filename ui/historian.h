@@ -26,27 +26,61 @@
 #include <stdio.h>
 #include <pthread.h>
 #include "ui_events.h"
+#include "linebuf.h"
+#include "eventloop.h"
+#include "cmdqueue.h"
+
+/* Messages such as large highscore tables are received in one piece, so the
+ * receive buffer grows up to the size of the largest message accepted */
+#define HISTORIAN_RECEIVE_BUFFER_SIZE		(16 * 1024)
+#define HISTORIAN_MAX_MESSAGE_SIZE			(4 * 1024 * 1024)
+#define HISTORIAN_RECONNECT_SECONDS			3
+#define HISTORIAN_MAX_QUEUED_COMMANDS		64
+#define HISTORIAN_MAX_PENDING_REQUESTS		16
+#define HISTORIAN_REQUEST_TIMEOUT_SECONDS	10
 
 enum historian_state_t {
 	UNCONNECTED,
 	CONNECTED,
 };
 
+struct historian_request_t {
+	unsigned int id;
+	char *body;
+	double sent_at;
+};
+
+/* Commands are queued and sent from the I/O side, i.e., a send thread of
+ * their own or the event loop. The mutex protects the socket and the queue;
+ * the generation changes with every connect and disconnect. */
 struct historian_t {
 	const char *unix_socket;
-	FILE *f_read, *f_write;
-	pthread_mutex_t f_mutex;
+	int fd;
+	unsigned int generation;
+	struct linebuf_t *rx_buffer;
+	struct cmdqueue_t *tx_queue;
+	pthread_mutex_t mutex;
+	pthread_cond_t send_cond;
 	enum historian_state_t connection_state;
 	ui_event_cb_t event_callback;
 	void *event_callback_ctx;
 	pthread_t connection_thread;
-	pthread_t receive_thread;
+	pthread_t send_thread;
+	bool connection_thread_running, send_thread_running;
+	struct eventloop_t *eventloop;
+	struct eventloop_source_t *read_source, *reconnect_timer, *send_wakeup;
+	bool want_writable;
+	unsigned int last_request_id;
+	struct historian_request_t pending_requests[HISTORIAN_MAX_PENDING_REQUESTS];
+	unsigned long skipped_status_messages;
 	bool running;
 };
 
 /*************** AUTO GENERATED SECTION FOLLOWS ***************/
-struct historian_t *historian_connect(const char *unix_socket, ui_event_cb_t historian_event_cb, void *callback_ctx);
+struct historian_t *historian_connect(const char *unix_socket, struct eventloop_t *eventloop, ui_event_cb_t historian_event_cb, void *callback_ctx);
 void historian_command(struct historian_t *historian, const char *cmdname, const char *params, ...);
+unsigned int historian_request(struct historian_t *historian, bool deduplicate, const char *cmdname, const char *params, ...);
+unsigned long historian_get_skipped_status_messages(struct historian_t *historian);
 void historian_simple_command(struct historian_t *historian, const char *cmdname);
 void historian_free(struct historian_t *historian);
 /***************  AUTO GENERATED SECTION ENDS   ***************/
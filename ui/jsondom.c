@@ -215,7 +215,8 @@ static struct jsondom_t *jsondom_new(enum jsondom_type_t elementtype, struct jso
 	return element;
 }
 
-struct jsondom_t *jsondom_parse(const char *json_text) {
+/* The text needs not be NUL terminated */
+struct jsondom_t *jsondom_parse_length(const char *json_text, size_t length) {
 	/* Now try to parse the JSON message that we received */
 	yajl_callbacks ycallbacks = {
 		.yajl_start_map = yajl_parse_start_map,
@@ -238,7 +239,7 @@ struct jsondom_t *jsondom_parse(const char *json_text) {
 		perror("yajl_alloc");
 		return NULL;
 	}
-	yajl_status parse_status = yajl_parse(yhandle, (unsigned char*)json_text, strlen(json_text));
+	yajl_status parse_status = yajl_parse(yhandle, (const unsigned char*)json_text, length);
 	yajl_free(yhandle);
 	if (parse_status != yajl_status_ok) {
 		return NULL;
@@ -247,6 +248,10 @@ struct jsondom_t *jsondom_parse(const char *json_text) {
 	return parsing_ctx.root;
 }
 
+struct jsondom_t *jsondom_parse(const char *json_text) {
+	return jsondom_parse_length(json_text, strlen(json_text));
+}
+
 static void jsondom_print_indent(unsigned int indent) {
 	for (int i = 0; i < indent; i++) {
 		printf("    ");
@@ -62,6 +62,7 @@ struct jsondom_t {
 };
 
 /*************** AUTO GENERATED SECTION FOLLOWS ***************/
+struct jsondom_t *jsondom_parse_length(const char *json_text, size_t length);
 struct jsondom_t *jsondom_parse(const char *json_text);
 void jsondom_dump(const struct jsondom_t *element);
 void jsondom_free(struct jsondom_t *element);
@@ -0,0 +1,182 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include "linebuf.h"
+
+struct linebuf_t *linebuf_init(size_t initial_size, size_t max_size) {
+	struct linebuf_t *linebuf = calloc(sizeof(struct linebuf_t), 1);
+	if (!linebuf) {
+		perror("calloc");
+		return NULL;
+	}
+	linebuf->size = (initial_size < max_size) ? initial_size : max_size;
+	linebuf->max_size = max_size;
+	linebuf->data = malloc(linebuf->size);
+	if (!linebuf->data) {
+		perror("malloc");
+		free(linebuf);
+		return NULL;
+	}
+	return linebuf;
+}
+
+/* Forgets all buffered data, e.g., when the connection is reestablished */
+void linebuf_reset(struct linebuf_t *linebuf) {
+	linebuf->head = 0;
+	linebuf->scanned = 0;
+	linebuf->tail = 0;
+}
+
+/* Makes room behind the received data, first by moving the partial line to
+ * the front and only then by growing the buffer */
+static bool linebuf_make_room(struct linebuf_t *linebuf) {
+	if (linebuf->tail < linebuf->size) {
+		return true;
+	}
+	if (linebuf->head) {
+		const size_t partial_length = linebuf->tail - linebuf->head;
+		memmove(linebuf->data, linebuf->data + linebuf->head, partial_length);
+		linebuf->scanned -= linebuf->head;
+		linebuf->tail = partial_length;
+		linebuf->head = 0;
+		return true;
+	}
+	if (linebuf->size >= linebuf->max_size) {
+		return false;
+	}
+
+	size_t new_size = linebuf->size * 2;
+	if (new_size > linebuf->max_size) {
+		new_size = linebuf->max_size;
+	}
+	char *new_data = realloc(linebuf->data, new_size);
+	if (!new_data) {
+		perror("realloc");
+		return false;
+	}
+	linebuf->data = new_data;
+	linebuf->size = new_size;
+	return true;
+}
+
+/* Reads whatever is available from the file descriptor. Returns the number of
+ * bytes read, 0 on EOF or -1 on error. If a single line does not fit into the
+ * maximum buffer size, fails with errno set to EMSGSIZE. */
+ssize_t linebuf_fill(struct linebuf_t *linebuf, int fd) {
+	if (!linebuf_make_room(linebuf)) {
+		errno = EMSGSIZE;
+		return -1;
+	}
+	while (true) {
+		ssize_t length = read(fd, linebuf->data + linebuf->tail, linebuf->size - linebuf->tail);
+		if ((length == -1) && (errno == EINTR)) {
+			continue;
+		}
+		if (length > 0) {
+			linebuf->tail += length;
+		}
+		return length;
+	}
+}
+
+/* Returns the next complete line with the line ending stripped and NUL
+ * terminated, or NULL if no complete line has been received yet. The line
+ * points into the buffer and stays valid until the next linebuf_fill(). */
+char *linebuf_next_line(struct linebuf_t *linebuf, size_t *length) {
+	char *newline = memchr(linebuf->data + linebuf->scanned, '\n', linebuf->tail - linebuf->scanned);
+	if (!newline) {
+		linebuf->scanned = linebuf->tail;
+		if (linebuf->head == linebuf->tail) {
+			/* Nothing buffered, so the next read may start at the front */
+			linebuf_reset(linebuf);
+		}
+		return NULL;
+	}
+
+	char *line = linebuf->data + linebuf->head;
+	size_t line_length = newline - line;
+	linebuf->head += line_length + 1;
+	linebuf->scanned = linebuf->head;
+	if (line_length && (line[line_length - 1] == '\r')) {
+		line_length--;
+	}
+	line[line_length] = 0;
+	if (length) {
+		*length = line_length;
+	}
+	return line;
+}
+
+void linebuf_free(struct linebuf_t *linebuf) {
+	if (!linebuf) {
+		return;
+	}
+	free(linebuf->data);
+	free(linebuf);
+}
+
+#ifdef TEST_LINEBUF
+
+// gcc -Wall -D_POSIX_C_SOURCE=200112L -D_XOPEN_SOURCE=500 -Wall -Wmissing-prototypes -Wstrict-prototypes -Werror=implicit-function-declaration -Werror=format -Wshadow -Wswitch -std=c11 -DTEST_LINEBUF linebuf.c -o linebuf -ggdb3 -fsanitize=address -fsanitize=undefined -fsanitize=leak -fno-omit-frame-pointer && ./linebuf
+
+static void receive(struct linebuf_t *linebuf, int fds[2], const char *data) {
+	const size_t length = strlen(data);
+	write(fds[1], data, length);
+	size_t received = 0;
+	while (received < length) {
+		ssize_t result = linebuf_fill(linebuf, fds[0]);
+		if (result <= 0) {
+			printf("Fill failed: %s\n", strerror(errno));
+			return;
+		}
+		received += result;
+		char *line;
+		size_t line_length;
+		while ((line = linebuf_next_line(linebuf, &line_length))) {
+			printf("RX %zu '%s'\n", line_length, line);
+		}
+	}
+	printf("Buffer size %zu\n", linebuf->size);
+}
+
+int main(void) {
+	int fds[2];
+	if (pipe(fds)) {
+		perror("pipe");
+		return 1;
+	}
+
+	struct linebuf_t *linebuf = linebuf_init(8, 64);
+	receive(linebuf, fds, "short\nsomewhat longer line\r\n\nsplit ");
+	receive(linebuf, fds, "across reads\n");
+	receive(linebuf, fds, "this line is longer than the sixty four bytes the buffer may grow to\n");
+	linebuf_free(linebuf);
+	close(fds[0]);
+	close(fds[1]);
+	return 0;
+}
+#endif
@@ -0,0 +1,51 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#ifndef __LINEBUF_H__
+#define __LINEBUF_H__
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+/* Receive buffer for newline delimited messages. Data is read straight into
+ * the buffer and complete lines are handed out in place; only the trailing
+ * partial line is ever moved, to the front of the buffer, to make room for
+ * the next read. The buffer grows as needed up to max_size, which therefore
+ * is the longest line that can be received. */
+struct linebuf_t {
+	char *data;
+	size_t size, max_size;
+	size_t head;		/* Start of the first line not handed out yet */
+	size_t scanned;		/* No newline between head and here */
+	size_t tail;		/* End of received data */
+};
+
+/*************** AUTO GENERATED SECTION FOLLOWS ***************/
+struct linebuf_t *linebuf_init(size_t initial_size, size_t max_size);
+void linebuf_reset(struct linebuf_t *linebuf);
+ssize_t linebuf_fill(struct linebuf_t *linebuf, int fd);
+char *linebuf_next_line(struct linebuf_t *linebuf, size_t *length);
+void linebuf_free(struct linebuf_t *linebuf);
+/***************  AUTO GENERATED SECTION ENDS   ***************/
+
+#endif
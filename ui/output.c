@@ -0,0 +1,174 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "output.h"
+#include "display_fb.h"
+#include "display_sdl.h"
+#include "display_null.h"
+#include "cyberblades-ui.h"
+
+/* Parses display arguments of the form "null:1920x1080" */
+static bool parse_display_geometry(const char *arg, const char *prefix, unsigned int *width, unsigned int *height, bool *valid) {
+	const unsigned int prefix_length = strlen(prefix);
+	if (strncmp(arg, prefix, prefix_length)) {
+		return false;
+	}
+	*valid = (sscanf(arg + prefix_length, "%ux%u", width, height) == 2) && *width && *height;
+	if (!*valid) {
+		fprintf(stderr, "Invalid display geometry, expected e.g. %s1920x1080: %s\n", prefix, arg);
+	}
+	return true;
+}
+
+static struct display_t *output_init_display(struct output_t *output, const char *display_spec) {
+	bool valid;
+	struct display_null_init_t headless_params;
+	struct display_sdl_init_t sdl_params = {
+		.width = 1920, .height = 1080,
+		.vsync = true,
+	};
+	if (!strcmp(display_spec, "sdl")) {
+		output->sdl = true;
+		return display_init(&display_sdl_calltable, &sdl_params);
+	} else if (parse_display_geometry(display_spec, "sdl:", &sdl_params.width, &sdl_params.height, &valid)) {
+		output->sdl = true;
+		return valid ? display_init(&display_sdl_calltable, &sdl_params) : NULL;
+	} else if (parse_display_geometry(display_spec, "null:", &headless_params.width, &headless_params.height, &valid)) {
+		output->headless = true;
+		return valid ? display_init(&display_null_calltable, &headless_params) : NULL;
+	} else if (parse_display_geometry(display_spec, "memory:", &headless_params.width, &headless_params.height, &valid)) {
+		output->headless = true;
+		return valid ? display_init(&display_memory_calltable, &headless_params) : NULL;
+	} else {
+		return display_init(&display_fb_calltable, (void*)display_spec);
+	}
+}
+
+/* Outputs are given as "display[,renderer[,render scale]]", where the display
+ * is "sdl", "sdl:WxH", "null:WxH", "memory:WxH" or a framebuffer device. The
+ * renderer defaults to the layout suiting the display resolution. */
+struct output_t *output_init(const char *spec) {
+	char spec_copy[256];
+	if (strlen(spec) >= sizeof(spec_copy)) {
+		fprintf(stderr, "Output specification too long: %s\n", spec);
+		return NULL;
+	}
+	strcpy(spec_copy, spec);
+	char *saveptr = NULL;
+	const char *display_spec = strtok_r(spec_copy, ",", &saveptr);
+	const char *renderer_name = strtok_r(NULL, ",", &saveptr);
+	const char *scale_spec = strtok_r(NULL, ",", &saveptr);
+	if (!display_spec || strtok_r(NULL, ",", &saveptr)) {
+		fprintf(stderr, "Invalid output specification, expected display[,renderer[,render scale]]: %s\n", spec);
+		return NULL;
+	}
+
+	struct output_t *output = calloc(sizeof(struct output_t), 1);
+	if (!output) {
+		perror("calloc");
+		return NULL;
+	}
+
+	/* Rendering at reduced resolution trades sharpness for frame time */
+	output->render_scale = RENDER_SCALE;
+	if (scale_spec) {
+		char *end;
+		output->render_scale = strtod(scale_spec, &end);
+		if ((*end != 0) || (output->render_scale <= 0) || (output->render_scale > 1)) {
+			fprintf(stderr, "Render scale must be in the range (0, 1]: %s\n", scale_spec);
+			output_free(output);
+			return NULL;
+		}
+	}
+
+	output->display = output_init_display(output, display_spec);
+	if (!output->display) {
+		fprintf(stderr, "Could not create display %s.\n", display_spec);
+		output_free(output);
+		return NULL;
+	}
+
+	/* Unless given explicitly, the layout is chosen to suit the display */
+	output->renderer = renderer_name ? renderer_find(renderer_name) : renderer_for_display(output->display->width, output->display->height);
+	if (!output->renderer) {
+		output_free(output);
+		return NULL;
+	}
+	if (output->renderer->state_size) {
+		output->renderer_state = calloc(output->renderer->state_size, 1);
+		if (!output->renderer_state) {
+			perror("calloc");
+			output_free(output);
+			return NULL;
+		}
+	}
+	fprintf(stderr, "Rendering %s layout on %u x %u display %s.\n", output->renderer->name, output->display->width, output->display->height, display_spec);
+	if (output->render_scale != 1) {
+		fprintf(stderr, "Rendering at %.0f%% resolution and upscaling.\n", output->render_scale * 100);
+	}
+
+	output->presenter = presenter_init(output->display, output->render_scale);
+	if (!output->presenter) {
+		fprintf(stderr, "Could not create presenter.\n");
+		output_free(output);
+		return NULL;
+	}
+
+	/* On displays that flip pages, render straight into video memory instead
+	 * of copying every frame over */
+	if (RENDER_DIRECT_TO_DISPLAY && presenter_set_direct(output->presenter, true)) {
+		fprintf(stderr, "Rendering directly into display memory.\n");
+	}
+	return output;
+}
+
+void output_render(struct output_t *output, const struct ui_state_t *ui_state) {
+	struct cairo_swbuf_t *swbuf = presenter_acquire(output->presenter);
+	output->renderer->render(ui_state, swbuf, output->renderer_state);
+	presenter_submit(output->presenter);
+}
+
+void output_print_stats(struct output_t *output) {
+	if (output->headless) {
+		display_null_print_stats(output->display);
+	}
+#ifdef DEVELOPMENT
+	struct presenter_stats_t stats;
+	presenter_get_stats(output->presenter, &stats);
+	fprintf(stderr, "Presenter %s: %lu frames submitted, %lu presented, %lu dropped\n", output->renderer->name, stats.frames_submitted, stats.frames_presented, stats.frames_dropped);
+#endif
+}
+
+void output_free(struct output_t *output) {
+	if (!output) {
+		return;
+	}
+	presenter_free(output->presenter);
+	if (output->display) {
+		display_free(output->display);
+	}
+	free(output->renderer_state);
+	free(output);
+}
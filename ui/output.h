@@ -0,0 +1,51 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#ifndef __OUTPUT_H__
+#define __OUTPUT_H__
+
+#include <stdbool.h>
+#include "display.h"
+#include "renderer.h"
+#include "presenter.h"
+
+/* One screen driven by the UI: a display with the layout rendered on it and
+ * the presenter, with its own buffers and present thread, that feeds it.
+ * All outputs render from the same UI state snapshot. */
+struct output_t {
+	struct display_t *display;
+	const struct renderer_t *renderer;
+	void *renderer_state;
+	struct presenter_t *presenter;
+	double render_scale;
+	bool headless;
+	bool sdl;
+};
+
+/*************** AUTO GENERATED SECTION FOLLOWS ***************/
+struct output_t *output_init(const char *spec);
+void output_render(struct output_t *output, const struct ui_state_t *ui_state);
+void output_print_stats(struct output_t *output);
+void output_free(struct output_t *output);
+/***************  AUTO GENERATED SECTION ENDS   ***************/
+
+#endif
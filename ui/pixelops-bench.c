@@ -0,0 +1,164 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pixelops.h"
+#include "tools.h"
+
+#define BENCH_WIDTH				1920
+#define BENCH_HEIGHT			1080
+#define BENCH_DEFAULT_FRAMES	200
+
+enum bench_kernel_t {
+	KERNEL_RGB565,
+	KERNEL_RGB565_DITHERED,
+	KERNEL_RGB888,
+	KERNEL_BGR888,
+	KERNEL_FILL32,
+	KERNEL_FILL16,
+	KERNEL_COPY,
+	KERNEL_SCALE_NEAREST32,
+	KERNEL_SCALE_NEAREST16,
+	KERNEL_SCALE_BILINEAR32,
+};
+
+static const char *kernel_names[] = {
+	[KERNEL_RGB565] = "argb32_to_rgb565",
+	[KERNEL_RGB565_DITHERED] = "argb32_to_rgb565_dithered",
+	[KERNEL_RGB888] = "argb32_to_rgb888",
+	[KERNEL_BGR888] = "argb32_to_bgr888",
+	[KERNEL_FILL32] = "fill32",
+	[KERNEL_FILL16] = "fill16",
+	[KERNEL_COPY] = "copy_rect",
+	[KERNEL_SCALE_NEAREST32] = "scale_nearest32 (x2)",
+	[KERNEL_SCALE_NEAREST16] = "scale_nearest16 (x2)",
+	[KERNEL_SCALE_BILINEAR32] = "scale_bilinear32 (x2)",
+};
+#define KERNEL_COUNT	(sizeof(kernel_names) / sizeof(const char*))
+
+/* Writes one full frame into dest; rows have an odd width on purpose so that
+ * the scalar tails of the SIMD kernels are exercised as well */
+static void bench_run_kernel(const struct pixelops_t *ops, enum bench_kernel_t kernel, uint8_t *dest, const uint32_t *src, unsigned int width) {
+	const unsigned int src_stride = sizeof(uint32_t) * BENCH_WIDTH;
+	switch (kernel) {
+		case KERNEL_RGB565:
+			pixelops_argb32_to_rgb565_rect(ops, dest, sizeof(uint16_t) * BENCH_WIDTH, src, src_stride, 0, 0, width, BENCH_HEIGHT, false);
+			break;
+
+		case KERNEL_RGB565_DITHERED:
+			pixelops_argb32_to_rgb565_rect(ops, dest, sizeof(uint16_t) * BENCH_WIDTH, src, src_stride, 0, 0, width, BENCH_HEIGHT, true);
+			break;
+
+		case KERNEL_RGB888:
+			pixelops_argb32_to_rgb24_rect(ops, dest, 3 * BENCH_WIDTH, src, src_stride, width, BENCH_HEIGHT, false);
+			break;
+
+		case KERNEL_BGR888:
+			pixelops_argb32_to_rgb24_rect(ops, dest, 3 * BENCH_WIDTH, src, src_stride, width, BENCH_HEIGHT, true);
+			break;
+
+		case KERNEL_FILL32:
+			pixelops_fill32_rect(ops, dest, src_stride, 0x123456, width, BENCH_HEIGHT);
+			break;
+
+		case KERNEL_FILL16:
+			pixelops_fill16_rect(ops, dest, sizeof(uint16_t) * BENCH_WIDTH, 0x1234, width, BENCH_HEIGHT);
+			break;
+
+		case KERNEL_COPY:
+			pixelops_copy_rect(dest, src_stride, src, src_stride, sizeof(uint32_t) * width, BENCH_HEIGHT);
+			break;
+
+		/* Upscaling from the top left quarter of the source frame */
+		case KERNEL_SCALE_NEAREST32:
+			pixelops_scale_rect(ops, dest, src_stride, 0, 0, width, BENCH_HEIGHT, src, src_stride, BENCH_WIDTH / 2, BENCH_HEIGHT / 2, 32, 0.5, false);
+			break;
+
+		case KERNEL_SCALE_NEAREST16:
+			pixelops_scale_rect(ops, dest, sizeof(uint16_t) * BENCH_WIDTH, 0, 0, width, BENCH_HEIGHT, src, src_stride, BENCH_WIDTH / 2, BENCH_HEIGHT / 2, 16, 0.5, false);
+			break;
+
+		case KERNEL_SCALE_BILINEAR32:
+			pixelops_scale_rect(ops, dest, src_stride, 0, 0, width, BENCH_HEIGHT, src, src_stride, BENCH_WIDTH / 2, BENCH_HEIGHT / 2, 32, 0.5, true);
+			break;
+	}
+}
+
+int main(int argc, char **argv) {
+	unsigned int frames = BENCH_DEFAULT_FRAMES;
+	if (argc >= 2) {
+		frames = atoi(argv[1]);
+	}
+	if ((argc > 2) || (frames == 0)) {
+		fprintf(stderr, "%s [frame count]\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	const size_t frame_size = sizeof(uint32_t) * BENCH_WIDTH * BENCH_HEIGHT;
+	uint32_t *src = malloc(frame_size);
+	uint8_t *dest = malloc(frame_size);
+	uint8_t *reference = malloc(frame_size);
+	if (!src || !dest || !reference) {
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	srand(0);
+	for (unsigned int i = 0; i < BENCH_WIDTH * BENCH_HEIGHT; i++) {
+		src[i] = 0xff000000 | ((rand() & 0xffff) << 8) | (rand() & 0xff);
+	}
+
+	const struct pixelops_t *scalar = pixelops_get_impl(PIXELOPS_SCALAR);
+	printf("%u frames of %ux%u per kernel, best available is %s\n", frames, BENCH_WIDTH, BENCH_HEIGHT, pixelops_get()->name);
+	printf("%-28s %-8s %10s %10s %8s\n", "Kernel", "Impl", "ms/frame", "MPixel/s", "Result");
+	bool all_match = true;
+	for (unsigned int kernel = 0; kernel < KERNEL_COUNT; kernel++) {
+		const unsigned int width = BENCH_WIDTH - 3;
+		memset(reference, 0, frame_size);
+		bench_run_kernel(scalar, kernel, reference, src, width);
+
+		for (unsigned int impl = 0; impl < PIXELOPS_IMPL_COUNT; impl++) {
+			const struct pixelops_t *ops = pixelops_get_impl(impl);
+			if (!ops) {
+				continue;
+			}
+
+			memset(dest, 0, frame_size);
+			bench_run_kernel(ops, kernel, dest, src, width);
+			const bool matches = !memcmp(dest, reference, frame_size);
+			all_match = all_match && matches;
+
+			double t0 = now();
+			for (unsigned int i = 0; i < frames; i++) {
+				bench_run_kernel(ops, kernel, dest, src, width);
+			}
+			const double total_time = now() - t0;
+			printf("%-28s %-8s %10.3f %10.1f %8s\n", kernel_names[kernel], ops->name, 1000 * total_time / frames, 1e-6 * frames * width * BENCH_HEIGHT / total_time, matches ? "ok" : "MISMATCH");
+		}
+	}
+
+	free(src);
+	free(dest);
+	free(reference);
+	return all_match ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,564 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "pixelops.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define HAVE_PIXELOPS_SSE2
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define HAVE_PIXELOPS_NEON
+#if defined(__arm__)
+#include <sys/auxv.h>
+#ifndef HWCAP_ARM_NEON
+#define HWCAP_ARM_NEON			(1 << 12)
+#endif
+#endif
+#endif
+
+/* 4x4 Bayer matrix, values 0..15. The 5 bit channels drop 3 bits and get half
+ * of this added, the 6 bit green channel drops 2 bits and gets a quarter. */
+static const uint8_t dither_matrix[4][4] = {
+	{  0,  8,  2, 10 },
+	{ 12,  4, 14,  6 },
+	{  3, 11,  1,  9 },
+	{ 15,  7, 13,  5 },
+};
+
+static uint8_t saturating_add_u8(uint8_t a, uint8_t b) {
+	unsigned int sum = a + b;
+	return (sum > 0xff) ? 0xff : sum;
+}
+
+static inline uint16_t argb32_to_rgb565_pixel(uint32_t argb) {
+	return ((argb >> 8) & 0xf800) | ((argb >> 5) & 0x07e0) | ((argb >> 3) & 0x001f);
+}
+
+static inline uint16_t argb32_to_rgb565_dithered_pixel(uint32_t argb, unsigned int x, unsigned int y) {
+	const uint8_t threshold = dither_matrix[y & 3][x & 3];
+	const uint8_t r = saturating_add_u8((argb >> 16) & 0xff, threshold >> 1);
+	const uint8_t g = saturating_add_u8((argb >> 8) & 0xff, threshold >> 2);
+	const uint8_t b = saturating_add_u8((argb >> 0) & 0xff, threshold >> 1);
+	return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+}
+
+/* Splits a fixed point source position into the left pixel's index and the
+ * weight (0..255) of its right neighbor, both clamped to the row */
+static inline unsigned int bilinear_position(int32_t fx, unsigned int src_width, unsigned int *weight) {
+	if (fx < 0) {
+		*weight = 0;
+		return 0;
+	}
+	const unsigned int x = fx >> 16;
+	if (x >= src_width - 1) {
+		*weight = 0;
+		return src_width - 1;
+	}
+	*weight = (fx >> 8) & 0xff;
+	return x;
+}
+
+static inline unsigned int nearest_position(int32_t fx, unsigned int src_width) {
+	if (fx < 0) {
+		return 0;
+	}
+	const unsigned int x = fx >> 16;
+	return (x >= src_width) ? (src_width - 1) : x;
+}
+
+/*************** Scalar ***************/
+static void scalar_argb32_to_rgb565(uint16_t *dest, const uint32_t *src, unsigned int count) {
+	for (unsigned int i = 0; i < count; i++) {
+		dest[i] = argb32_to_rgb565_pixel(src[i]);
+	}
+}
+
+static void scalar_argb32_to_rgb565_dithered(uint16_t *dest, const uint32_t *src, unsigned int count, unsigned int x, unsigned int y) {
+	for (unsigned int i = 0; i < count; i++) {
+		dest[i] = argb32_to_rgb565_dithered_pixel(src[i], x + i, y);
+	}
+}
+
+static void scalar_argb32_to_rgb888(uint8_t *dest, const uint32_t *src, unsigned int count) {
+	for (unsigned int i = 0; i < count; i++) {
+		dest[(3 * i) + 0] = (src[i] >> 16) & 0xff;
+		dest[(3 * i) + 1] = (src[i] >> 8) & 0xff;
+		dest[(3 * i) + 2] = (src[i] >> 0) & 0xff;
+	}
+}
+
+static void scalar_argb32_to_bgr888(uint8_t *dest, const uint32_t *src, unsigned int count) {
+	for (unsigned int i = 0; i < count; i++) {
+		dest[(3 * i) + 0] = (src[i] >> 0) & 0xff;
+		dest[(3 * i) + 1] = (src[i] >> 8) & 0xff;
+		dest[(3 * i) + 2] = (src[i] >> 16) & 0xff;
+	}
+}
+
+static void scalar_fill32(uint32_t *dest, uint32_t value, unsigned int count) {
+	for (unsigned int i = 0; i < count; i++) {
+		dest[i] = value;
+	}
+}
+
+static void scalar_fill16(uint16_t *dest, uint16_t value, unsigned int count) {
+	for (unsigned int i = 0; i < count; i++) {
+		dest[i] = value;
+	}
+}
+
+static void scalar_scale_nearest32(uint32_t *dest, const uint32_t *src, unsigned int src_width, unsigned int count, int32_t x0, int32_t step) {
+	for (unsigned int i = 0; i < count; i++) {
+		dest[i] = src[nearest_position(x0 + ((int32_t)i * step), src_width)];
+	}
+}
+
+static void scalar_scale_nearest16(uint16_t *dest, const uint16_t *src, unsigned int src_width, unsigned int count, int32_t x0, int32_t step) {
+	for (unsigned int i = 0; i < count; i++) {
+		dest[i] = src[nearest_position(x0 + ((int32_t)i * step), src_width)];
+	}
+}
+
+static inline uint32_t bilinear_pixel(uint32_t p00, uint32_t p01, uint32_t p10, uint32_t p11, unsigned int x_weight, unsigned int y_weight) {
+	uint32_t result = 0;
+	for (unsigned int shift = 0; shift < 32; shift += 8) {
+		const unsigned int top = ((((p00 >> shift) & 0xff) * (256 - x_weight)) + (((p01 >> shift) & 0xff) * x_weight)) >> 8;
+		const unsigned int bottom = ((((p10 >> shift) & 0xff) * (256 - x_weight)) + (((p11 >> shift) & 0xff) * x_weight)) >> 8;
+		result |= (((top * (256 - y_weight)) + (bottom * y_weight)) >> 8) << shift;
+	}
+	return result;
+}
+
+static void scalar_scale_bilinear32(uint32_t *dest, const uint32_t *src0, const uint32_t *src1, unsigned int src_width, unsigned int count, int32_t x0, int32_t step, unsigned int y_weight) {
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned int x_weight;
+		const unsigned int x = bilinear_position(x0 + ((int32_t)i * step), src_width, &x_weight);
+		const unsigned int x_right = x_weight ? (x + 1) : x;
+		dest[i] = bilinear_pixel(src0[x], src0[x_right], src1[x], src1[x_right], x_weight, y_weight);
+	}
+}
+
+static const struct pixelops_t pixelops_scalar = {
+	.impl = PIXELOPS_SCALAR,
+	.name = "scalar",
+	.argb32_to_rgb565 = scalar_argb32_to_rgb565,
+	.argb32_to_rgb565_dithered = scalar_argb32_to_rgb565_dithered,
+	.argb32_to_rgb888 = scalar_argb32_to_rgb888,
+	.argb32_to_bgr888 = scalar_argb32_to_bgr888,
+	.fill32 = scalar_fill32,
+	.fill16 = scalar_fill16,
+	.scale_nearest32 = scalar_scale_nearest32,
+	.scale_nearest16 = scalar_scale_nearest16,
+	.scale_bilinear32 = scalar_scale_bilinear32,
+};
+
+/*************** SSE2 ***************/
+#ifdef HAVE_PIXELOPS_SSE2
+/* Converts four pixels to RGB565 in the low half of each 32 bit lane,
+ * sign-extended so that _mm_packs_epi32 does not saturate them */
+static inline __m128i sse2_rgb565_lanes(__m128i argb) {
+	__m128i r = _mm_and_si128(_mm_srli_epi32(argb, 8), _mm_set1_epi32(0xf800));
+	__m128i g = _mm_and_si128(_mm_srli_epi32(argb, 5), _mm_set1_epi32(0x07e0));
+	__m128i b = _mm_and_si128(_mm_srli_epi32(argb, 3), _mm_set1_epi32(0x001f));
+	__m128i rgb = _mm_or_si128(_mm_or_si128(r, g), b);
+	return _mm_srai_epi32(_mm_slli_epi32(rgb, 16), 16);
+}
+
+static void sse2_argb32_to_rgb565(uint16_t *dest, const uint32_t *src, unsigned int count) {
+	unsigned int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i lo = sse2_rgb565_lanes(_mm_loadu_si128((const __m128i*)(src + i)));
+		__m128i hi = sse2_rgb565_lanes(_mm_loadu_si128((const __m128i*)(src + i + 4)));
+		_mm_storeu_si128((__m128i*)(dest + i), _mm_packs_epi32(lo, hi));
+	}
+	scalar_argb32_to_rgb565(dest + i, src + i, count - i);
+}
+
+static void sse2_argb32_to_rgb565_dithered(uint16_t *dest, const uint32_t *src, unsigned int count, unsigned int x, unsigned int y) {
+	/* Each step advances by a multiple of four pixels, so the per-lane
+	 * thresholds are the same for the whole row */
+	uint32_t thresholds[4];
+	for (unsigned int lane = 0; lane < 4; lane++) {
+		const uint8_t threshold = dither_matrix[y & 3][(x + lane) & 3];
+		thresholds[lane] = ((threshold >> 1) << 16) | ((threshold >> 2) << 8) | (threshold >> 1);
+	}
+	const __m128i dither = _mm_loadu_si128((const __m128i*)thresholds);
+
+	unsigned int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i lo = _mm_adds_epu8(_mm_loadu_si128((const __m128i*)(src + i)), dither);
+		__m128i hi = _mm_adds_epu8(_mm_loadu_si128((const __m128i*)(src + i + 4)), dither);
+		_mm_storeu_si128((__m128i*)(dest + i), _mm_packs_epi32(sse2_rgb565_lanes(lo), sse2_rgb565_lanes(hi)));
+	}
+	scalar_argb32_to_rgb565_dithered(dest + i, src + i, count - i, x + i, y);
+}
+
+static void sse2_fill32(uint32_t *dest, uint32_t value, unsigned int count) {
+	const __m128i pattern = _mm_set1_epi32(value);
+	unsigned int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		_mm_storeu_si128((__m128i*)(dest + i), pattern);
+	}
+	scalar_fill32(dest + i, value, count - i);
+}
+
+static void sse2_fill16(uint16_t *dest, uint16_t value, unsigned int count) {
+	const __m128i pattern = _mm_set1_epi16(value);
+	unsigned int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		_mm_storeu_si128((__m128i*)(dest + i), pattern);
+	}
+	scalar_fill16(dest + i, value, count - i);
+}
+
+/* Two pixels per step, all channels widened to 16 bit lanes. The products
+ * never exceed 255 * 256, so the arithmetic is identical to the scalar one. */
+static void sse2_scale_bilinear32(uint32_t *dest, const uint32_t *src0, const uint32_t *src1, unsigned int src_width, unsigned int count, int32_t x0, int32_t step, unsigned int y_weight) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i y_weights = _mm_set1_epi16(y_weight);
+	const __m128i y_inverse = _mm_set1_epi16(256 - y_weight);
+	unsigned int i = 0;
+	for (; i + 2 <= count; i += 2) {
+		unsigned int wa, wb;
+		const unsigned int xa = bilinear_position(x0 + ((int32_t)i * step), src_width, &wa);
+		const unsigned int xb = bilinear_position(x0 + ((int32_t)(i + 1) * step), src_width, &wb);
+		const unsigned int xa_right = wa ? (xa + 1) : xa;
+		const unsigned int xb_right = wb ? (xb + 1) : xb;
+
+		const __m128i x_weights = _mm_set_epi16(wb, wb, wb, wb, wa, wa, wa, wa);
+		const __m128i x_inverse = _mm_sub_epi16(_mm_set1_epi16(256), x_weights);
+		const __m128i p00 = _mm_unpacklo_epi8(_mm_set_epi32(0, 0, src0[xb], src0[xa]), zero);
+		const __m128i p01 = _mm_unpacklo_epi8(_mm_set_epi32(0, 0, src0[xb_right], src0[xa_right]), zero);
+		const __m128i p10 = _mm_unpacklo_epi8(_mm_set_epi32(0, 0, src1[xb], src1[xa]), zero);
+		const __m128i p11 = _mm_unpacklo_epi8(_mm_set_epi32(0, 0, src1[xb_right], src1[xa_right]), zero);
+
+		const __m128i top = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(p00, x_inverse), _mm_mullo_epi16(p01, x_weights)), 8);
+		const __m128i bottom = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(p10, x_inverse), _mm_mullo_epi16(p11, x_weights)), 8);
+		const __m128i result = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(top, y_inverse), _mm_mullo_epi16(bottom, y_weights)), 8);
+		_mm_storel_epi64((__m128i*)(dest + i), _mm_packus_epi16(result, zero));
+	}
+	scalar_scale_bilinear32(dest + i, src0, src1, src_width, count - i, x0 + ((int32_t)i * step), step, y_weight);
+}
+
+/* SSE2 has no byte shuffle, so packing to 24 bit stays scalar; nearest
+ * neighbor scaling is a gather and gains nothing from it either */
+static const struct pixelops_t pixelops_sse2 = {
+	.impl = PIXELOPS_SSE2,
+	.name = "sse2",
+	.argb32_to_rgb565 = sse2_argb32_to_rgb565,
+	.argb32_to_rgb565_dithered = sse2_argb32_to_rgb565_dithered,
+	.argb32_to_rgb888 = scalar_argb32_to_rgb888,
+	.argb32_to_bgr888 = scalar_argb32_to_bgr888,
+	.fill32 = sse2_fill32,
+	.fill16 = sse2_fill16,
+	.scale_nearest32 = scalar_scale_nearest32,
+	.scale_nearest16 = scalar_scale_nearest16,
+	.scale_bilinear32 = sse2_scale_bilinear32,
+};
+#endif
+
+/*************** NEON ***************/
+#ifdef HAVE_PIXELOPS_NEON
+static inline uint16x8_t neon_pack_rgb565(uint8x8_t r, uint8x8_t g, uint8x8_t b) {
+	uint16x8_t rgb = vshll_n_u8(r, 8);
+	rgb = vsriq_n_u16(rgb, vshll_n_u8(g, 8), 5);
+	rgb = vsriq_n_u16(rgb, vshll_n_u8(b, 8), 11);
+	return rgb;
+}
+
+/* vld4 deinterleaves eight little endian ARGB32 pixels into B, G, R, A */
+static void neon_argb32_to_rgb565(uint16_t *dest, const uint32_t *src, unsigned int count) {
+	unsigned int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		uint8x8x4_t bgra = vld4_u8((const uint8_t*)(src + i));
+		vst1q_u16(dest + i, neon_pack_rgb565(bgra.val[2], bgra.val[1], bgra.val[0]));
+	}
+	scalar_argb32_to_rgb565(dest + i, src + i, count - i);
+}
+
+static void neon_argb32_to_rgb565_dithered(uint16_t *dest, const uint32_t *src, unsigned int count, unsigned int x, unsigned int y) {
+	uint8_t rb_thresholds[8], g_thresholds[8];
+	for (unsigned int lane = 0; lane < 8; lane++) {
+		const uint8_t threshold = dither_matrix[y & 3][(x + lane) & 3];
+		rb_thresholds[lane] = threshold >> 1;
+		g_thresholds[lane] = threshold >> 2;
+	}
+	const uint8x8_t rb_dither = vld1_u8(rb_thresholds);
+	const uint8x8_t g_dither = vld1_u8(g_thresholds);
+
+	unsigned int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		uint8x8x4_t bgra = vld4_u8((const uint8_t*)(src + i));
+		uint8x8_t r = vqadd_u8(bgra.val[2], rb_dither);
+		uint8x8_t g = vqadd_u8(bgra.val[1], g_dither);
+		uint8x8_t b = vqadd_u8(bgra.val[0], rb_dither);
+		vst1q_u16(dest + i, neon_pack_rgb565(r, g, b));
+	}
+	scalar_argb32_to_rgb565_dithered(dest + i, src + i, count - i, x + i, y);
+}
+
+static void neon_argb32_to_rgb888(uint8_t *dest, const uint32_t *src, unsigned int count) {
+	unsigned int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		uint8x8x4_t bgra = vld4_u8((const uint8_t*)(src + i));
+		uint8x8x3_t rgb;
+		rgb.val[0] = bgra.val[2];
+		rgb.val[1] = bgra.val[1];
+		rgb.val[2] = bgra.val[0];
+		vst3_u8(dest + (3 * i), rgb);
+	}
+	scalar_argb32_to_rgb888(dest + (3 * i), src + i, count - i);
+}
+
+static void neon_argb32_to_bgr888(uint8_t *dest, const uint32_t *src, unsigned int count) {
+	unsigned int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		uint8x8x4_t bgra = vld4_u8((const uint8_t*)(src + i));
+		uint8x8x3_t bgr;
+		bgr.val[0] = bgra.val[0];
+		bgr.val[1] = bgra.val[1];
+		bgr.val[2] = bgra.val[2];
+		vst3_u8(dest + (3 * i), bgr);
+	}
+	scalar_argb32_to_bgr888(dest + (3 * i), src + i, count - i);
+}
+
+static void neon_fill32(uint32_t *dest, uint32_t value, unsigned int count) {
+	const uint32x4_t pattern = vdupq_n_u32(value);
+	unsigned int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		vst1q_u32(dest + i, pattern);
+	}
+	scalar_fill32(dest + i, value, count - i);
+}
+
+static void neon_fill16(uint16_t *dest, uint16_t value, unsigned int count) {
+	const uint16x8_t pattern = vdupq_n_u16(value);
+	unsigned int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		vst1q_u16(dest + i, pattern);
+	}
+	scalar_fill16(dest + i, value, count - i);
+}
+
+static inline uint16x8_t neon_widen_pair(uint32_t a, uint32_t b) {
+	return vmovl_u8(vcreate_u8(((uint64_t)b << 32) | a));
+}
+
+/* Same scheme as the SSE2 kernel: two pixels in 16 bit lanes per step */
+static void neon_scale_bilinear32(uint32_t *dest, const uint32_t *src0, const uint32_t *src1, unsigned int src_width, unsigned int count, int32_t x0, int32_t step, unsigned int y_weight) {
+	const uint16x8_t y_weights = vdupq_n_u16(y_weight);
+	const uint16x8_t y_inverse = vdupq_n_u16(256 - y_weight);
+	unsigned int i = 0;
+	for (; i + 2 <= count; i += 2) {
+		unsigned int wa, wb;
+		const unsigned int xa = bilinear_position(x0 + ((int32_t)i * step), src_width, &wa);
+		const unsigned int xb = bilinear_position(x0 + ((int32_t)(i + 1) * step), src_width, &wb);
+		const unsigned int xa_right = wa ? (xa + 1) : xa;
+		const unsigned int xb_right = wb ? (xb + 1) : xb;
+
+		const uint16x8_t x_weights = vcombine_u16(vdup_n_u16(wa), vdup_n_u16(wb));
+		const uint16x8_t x_inverse = vsubq_u16(vdupq_n_u16(256), x_weights);
+		const uint16x8_t p00 = neon_widen_pair(src0[xa], src0[xb]);
+		const uint16x8_t p01 = neon_widen_pair(src0[xa_right], src0[xb_right]);
+		const uint16x8_t p10 = neon_widen_pair(src1[xa], src1[xb]);
+		const uint16x8_t p11 = neon_widen_pair(src1[xa_right], src1[xb_right]);
+
+		const uint16x8_t top = vshrq_n_u16(vmlaq_u16(vmulq_u16(p00, x_inverse), p01, x_weights), 8);
+		const uint16x8_t bottom = vshrq_n_u16(vmlaq_u16(vmulq_u16(p10, x_inverse), p11, x_weights), 8);
+		const uint16x8_t result = vshrq_n_u16(vmlaq_u16(vmulq_u16(top, y_inverse), bottom, y_weights), 8);
+		vst1_u8((uint8_t*)(dest + i), vmovn_u16(result));
+	}
+	scalar_scale_bilinear32(dest + i, src0, src1, src_width, count - i, x0 + ((int32_t)i * step), step, y_weight);
+}
+
+static const struct pixelops_t pixelops_neon = {
+	.impl = PIXELOPS_NEON,
+	.name = "neon",
+	.argb32_to_rgb565 = neon_argb32_to_rgb565,
+	.argb32_to_rgb565_dithered = neon_argb32_to_rgb565_dithered,
+	.argb32_to_rgb888 = neon_argb32_to_rgb888,
+	.argb32_to_bgr888 = neon_argb32_to_bgr888,
+	.fill32 = neon_fill32,
+	.fill16 = neon_fill16,
+	.scale_nearest32 = scalar_scale_nearest32,
+	.scale_nearest16 = scalar_scale_nearest16,
+	.scale_bilinear32 = neon_scale_bilinear32,
+};
+#endif
+
+/*************** Runtime selection ***************/
+static bool pixelops_cpu_supports(enum pixelops_impl_t impl) {
+	switch (impl) {
+		case PIXELOPS_SCALAR:
+			return true;
+
+		case PIXELOPS_SSE2:
+#ifdef HAVE_PIXELOPS_SSE2
+			return __builtin_cpu_supports("sse2");
+#else
+			return false;
+#endif
+
+		case PIXELOPS_NEON:
+#if defined(HAVE_PIXELOPS_NEON) && defined(__arm__)
+			/* 32 bit ARM builds may run on cores without NEON */
+			return (getauxval(AT_HWCAP) & HWCAP_ARM_NEON) != 0;
+#elif defined(HAVE_PIXELOPS_NEON)
+			return true;
+#else
+			return false;
+#endif
+	}
+	return false;
+}
+
+/* Returns NULL if the implementation was not compiled in or is not supported
+ * by the CPU that is running */
+const struct pixelops_t *pixelops_get_impl(enum pixelops_impl_t impl) {
+	if (!pixelops_cpu_supports(impl)) {
+		return NULL;
+	}
+	switch (impl) {
+		case PIXELOPS_SCALAR:
+			return &pixelops_scalar;
+
+		case PIXELOPS_SSE2:
+#ifdef HAVE_PIXELOPS_SSE2
+			return &pixelops_sse2;
+#else
+			return NULL;
+#endif
+
+		case PIXELOPS_NEON:
+#ifdef HAVE_PIXELOPS_NEON
+			return &pixelops_neon;
+#else
+			return NULL;
+#endif
+	}
+	return NULL;
+}
+
+static const struct pixelops_t *pixelops_best;
+static pthread_once_t pixelops_best_once = PTHREAD_ONCE_INIT;
+
+static void pixelops_select_best(void) {
+	const enum pixelops_impl_t preference[] = { PIXELOPS_NEON, PIXELOPS_SSE2, PIXELOPS_SCALAR };
+	for (unsigned int i = 0; i < sizeof(preference) / sizeof(enum pixelops_impl_t); i++) {
+		pixelops_best = pixelops_get_impl(preference[i]);
+		if (pixelops_best) {
+			break;
+		}
+	}
+#ifdef DEVELOPMENT
+	fprintf(stderr, "Using %s pixel operations.\n", pixelops_best->name);
+#endif
+}
+
+const struct pixelops_t *pixelops_get(void) {
+	pthread_once(&pixelops_best_once, pixelops_select_best);
+	return pixelops_best;
+}
+
+/*************** Rectangle helpers ***************/
+void pixelops_copy_rect(void *dest, unsigned int dest_stride, const void *src, unsigned int src_stride, unsigned int row_bytes, unsigned int height) {
+	if ((dest_stride == row_bytes) && (src_stride == row_bytes)) {
+		memcpy(dest, src, row_bytes * height);
+		return;
+	}
+	for (unsigned int y = 0; y < height; y++) {
+		memcpy((uint8_t*)dest + (y * dest_stride), (const uint8_t*)src + (y * src_stride), row_bytes);
+	}
+}
+
+/* (x, y) is the screen position of the rectangle's top left pixel, only used
+ * to align the dither pattern */
+void pixelops_argb32_to_rgb565_rect(const struct pixelops_t *ops, void *dest, unsigned int dest_stride, const uint32_t *src, unsigned int src_stride, unsigned int x, unsigned int y, unsigned int width, unsigned int height, bool dither) {
+	for (unsigned int row = 0; row < height; row++) {
+		uint16_t *dest_row = (uint16_t*)((uint8_t*)dest + (row * dest_stride));
+		const uint32_t *src_row = (const uint32_t*)((const uint8_t*)src + (row * src_stride));
+		if (dither) {
+			ops->argb32_to_rgb565_dithered(dest_row, src_row, width, x, y + row);
+		} else {
+			ops->argb32_to_rgb565(dest_row, src_row, width);
+		}
+	}
+}
+
+void pixelops_argb32_to_rgb24_rect(const struct pixelops_t *ops, void *dest, unsigned int dest_stride, const uint32_t *src, unsigned int src_stride, unsigned int width, unsigned int height, bool bgr) {
+	for (unsigned int row = 0; row < height; row++) {
+		uint8_t *dest_row = (uint8_t*)dest + (row * dest_stride);
+		const uint32_t *src_row = (const uint32_t*)((const uint8_t*)src + (row * src_stride));
+		if (bgr) {
+			ops->argb32_to_bgr888(dest_row, src_row, width);
+		} else {
+			ops->argb32_to_rgb888(dest_row, src_row, width);
+		}
+	}
+}
+
+void pixelops_fill32_rect(const struct pixelops_t *ops, void *dest, unsigned int dest_stride, uint32_t value, unsigned int width, unsigned int height) {
+	for (unsigned int row = 0; row < height; row++) {
+		ops->fill32((uint32_t*)((uint8_t*)dest + (row * dest_stride)), value, width);
+	}
+}
+
+void pixelops_fill16_rect(const struct pixelops_t *ops, void *dest, unsigned int dest_stride, uint16_t value, unsigned int width, unsigned int height) {
+	for (unsigned int row = 0; row < height; row++) {
+		ops->fill16((uint16_t*)((uint8_t*)dest + (row * dest_stride)), value, width);
+	}
+}
+
+/* Resamples the destination rectangle (dest_x, dest_y, width, height) of an
+ * image that is the source scaled by the given factor. dest and src both point
+ * to the top left of their whole images. Pixel centers are aligned, so the
+ * result doesn't shift. Bilinear filtering is only available for 32 bpp. */
+void pixelops_scale_rect(const struct pixelops_t *ops, void *dest, unsigned int dest_stride, unsigned int dest_x, unsigned int dest_y, unsigned int width, unsigned int height, const void *src, unsigned int src_stride, unsigned int src_width, unsigned int src_height, unsigned int bits_per_pixel, double scale, bool bilinear) {
+	const int32_t step = lround(65536 / scale);
+	const int32_t offset = bilinear ? ((step / 2) - 32768) : (step / 2);
+	const int32_t x0 = ((int32_t)dest_x * step) + offset;
+	for (unsigned int row = 0; row < height; row++) {
+		uint8_t *dest_row = (uint8_t*)dest + ((dest_y + row) * dest_stride);
+		const int32_t fy = ((int32_t)(dest_y + row) * step) + offset;
+		if (bits_per_pixel == 16) {
+			const uint16_t *src_row = (const uint16_t*)((const uint8_t*)src + (nearest_position(fy, src_height) * src_stride));
+			ops->scale_nearest16((uint16_t*)dest_row + dest_x, src_row, src_width, width, x0, step);
+		} else if (!bilinear) {
+			const uint32_t *src_row = (const uint32_t*)((const uint8_t*)src + (nearest_position(fy, src_height) * src_stride));
+			ops->scale_nearest32((uint32_t*)dest_row + dest_x, src_row, src_width, width, x0, step);
+		} else {
+			unsigned int y_weight;
+			const unsigned int y = bilinear_position(fy, src_height, &y_weight);
+			const uint32_t *src_row0 = (const uint32_t*)((const uint8_t*)src + (y * src_stride));
+			const uint32_t *src_row1 = (const uint32_t*)((const uint8_t*)src + ((y_weight ? (y + 1) : y) * src_stride));
+			ops->scale_bilinear32((uint32_t*)dest_row + dest_x, src_row0, src_row1, src_width, width, x0, step, y_weight);
+		}
+	}
+}
@@ -0,0 +1,72 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#ifndef __PIXELOPS_H__
+#define __PIXELOPS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+enum pixelops_impl_t {
+	PIXELOPS_SCALAR = 0,
+	PIXELOPS_SSE2 = 1,
+	PIXELOPS_NEON = 2,
+};
+#define PIXELOPS_IMPL_COUNT		3
+
+/* Kernels that each process a single row of pixels. Sources are always
+ * ARGB32 in native byte order, as produced by cairo; the alpha channel is
+ * ignored. */
+struct pixelops_t {
+	enum pixelops_impl_t impl;
+	const char *name;
+	void (*argb32_to_rgb565)(uint16_t *dest, const uint32_t *src, unsigned int count);
+	/* (x, y) is the screen position of the first pixel, which determines
+	 * the phase of the 4x4 ordered dither matrix */
+	void (*argb32_to_rgb565_dithered)(uint16_t *dest, const uint32_t *src, unsigned int count, unsigned int x, unsigned int y);
+	/* Byte order in memory is R, G, B */
+	void (*argb32_to_rgb888)(uint8_t *dest, const uint32_t *src, unsigned int count);
+	/* Byte order in memory is B, G, R */
+	void (*argb32_to_bgr888)(uint8_t *dest, const uint32_t *src, unsigned int count);
+	void (*fill32)(uint32_t *dest, uint32_t value, unsigned int count);
+	void (*fill16)(uint16_t *dest, uint16_t value, unsigned int count);
+	/* Resampling: destination pixel i is taken from source position
+	 * x0 + i * step (16.16 fixed point), clamped to the source row */
+	void (*scale_nearest32)(uint32_t *dest, const uint32_t *src, unsigned int src_width, unsigned int count, int32_t x0, int32_t step);
+	void (*scale_nearest16)(uint16_t *dest, const uint16_t *src, unsigned int src_width, unsigned int count, int32_t x0, int32_t step);
+	/* Interpolates between two source rows, y_weight (0..255) is the weight
+	 * of the second one */
+	void (*scale_bilinear32)(uint32_t *dest, const uint32_t *src0, const uint32_t *src1, unsigned int src_width, unsigned int count, int32_t x0, int32_t step, unsigned int y_weight);
+};
+
+/*************** AUTO GENERATED SECTION FOLLOWS ***************/
+const struct pixelops_t *pixelops_get_impl(enum pixelops_impl_t impl);
+const struct pixelops_t *pixelops_get(void);
+void pixelops_copy_rect(void *dest, unsigned int dest_stride, const void *src, unsigned int src_stride, unsigned int row_bytes, unsigned int height);
+void pixelops_argb32_to_rgb565_rect(const struct pixelops_t *ops, void *dest, unsigned int dest_stride, const uint32_t *src, unsigned int src_stride, unsigned int x, unsigned int y, unsigned int width, unsigned int height, bool dither);
+void pixelops_argb32_to_rgb24_rect(const struct pixelops_t *ops, void *dest, unsigned int dest_stride, const uint32_t *src, unsigned int src_stride, unsigned int width, unsigned int height, bool bgr);
+void pixelops_fill32_rect(const struct pixelops_t *ops, void *dest, unsigned int dest_stride, uint32_t value, unsigned int width, unsigned int height);
+void pixelops_fill16_rect(const struct pixelops_t *ops, void *dest, unsigned int dest_stride, uint16_t value, unsigned int width, unsigned int height);
+void pixelops_scale_rect(const struct pixelops_t *ops, void *dest, unsigned int dest_stride, unsigned int dest_x, unsigned int dest_y, unsigned int width, unsigned int height, const void *src, unsigned int src_stride, unsigned int src_width, unsigned int src_height, unsigned int bits_per_pixel, double scale, bool bilinear);
+/***************  AUTO GENERATED SECTION ENDS   ***************/
+
+#endif
@@ -0,0 +1,87 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "playercache.h"
+#include "tools.h"
+
+struct playercache_t *playercache_init(void) {
+	struct playercache_t *cache = calloc(sizeof(struct playercache_t), 1);
+	if (!cache) {
+		perror("calloc");
+		return NULL;
+	}
+	return cache;
+}
+
+static bool song_metadata_equal(const struct song_metadata_t *a, const struct song_metadata_t *b) {
+	return !strcmp(a->song_author, b->song_author) && !strcmp(a->song_title, b->song_title) && !strcmp(a->level_author, b->level_author) && (a->difficulty == b->difficulty);
+}
+
+/* Without a song, the most recently stored entry of the player is returned */
+const struct playercache_entry_t *playercache_lookup(const struct playercache_t *cache, const char *player, const struct song_metadata_t *song) {
+	const struct playercache_entry_t *result = NULL;
+	for (unsigned int i = 0; i < PLAYERCACHE_SIZE; i++) {
+		const struct playercache_entry_t *entry = &cache->entries[i];
+		if (!entry->used || strcmp(entry->player.name, player)) {
+			continue;
+		}
+		if (song && !song_metadata_equal(&entry->highscores.song_key, song)) {
+			continue;
+		}
+		if (!result || (entry->stored_at > result->stored_at)) {
+			result = entry;
+		}
+	}
+	return result;
+}
+
+/* Replaces the entry of the same player and song or else the least recently
+ * stored one */
+void playercache_store(struct playercache_t *cache, const struct player_info_t *player, const struct highscore_table_t *highscores) {
+	struct playercache_entry_t *slot = (struct playercache_entry_t*)playercache_lookup(cache, player->name, &highscores->song_key);
+	if (!slot) {
+		slot = &cache->entries[0];
+		for (unsigned int i = 0; i < PLAYERCACHE_SIZE; i++) {
+			struct playercache_entry_t *entry = &cache->entries[i];
+			if (!entry->used) {
+				slot = entry;
+				break;
+			}
+			if (entry->stored_at < slot->stored_at) {
+				slot = entry;
+			}
+		}
+	}
+	*slot = (struct playercache_entry_t) {
+		.used = true,
+		.stored_at = now(),
+		.player = *player,
+		.highscores = *highscores,
+	};
+}
+
+void playercache_free(struct playercache_t *cache) {
+	free(cache);
+}
@@ -0,0 +1,52 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#ifndef __PLAYERCACHE_H__
+#define __PLAYERCACHE_H__
+
+#include <stdbool.h>
+#include "cyberblades-ui.h"
+
+#define PLAYERCACHE_SIZE		8
+
+struct playercache_entry_t {
+	bool used;
+	double stored_at;
+	struct player_info_t player;
+	struct highscore_table_t highscores;
+};
+
+/* Player information as last received from the historian, one entry per
+ * player and song of the highscore table. Lets the UI show a player that was
+ * recently switched back to right away, while a fresh copy is requested. */
+struct playercache_t {
+	struct playercache_entry_t entries[PLAYERCACHE_SIZE];
+};
+
+/*************** AUTO GENERATED SECTION FOLLOWS ***************/
+struct playercache_t *playercache_init(void);
+const struct playercache_entry_t *playercache_lookup(const struct playercache_t *cache, const char *player, const struct song_metadata_t *song);
+void playercache_store(struct playercache_t *cache, const struct player_info_t *player, const struct highscore_table_t *highscores);
+void playercache_free(struct playercache_t *cache);
+/***************  AUTO GENERATED SECTION ENDS   ***************/
+
+#endif
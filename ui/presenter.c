@@ -0,0 +1,272 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "presenter.h"
+#include "cairoglue.h"
+
+static void* presenter_thread_fnc(void *vpresenter) {
+	struct presenter_t *presenter = (struct presenter_t*)vpresenter;
+	pthread_mutex_lock(&presenter->mutex);
+	while (true) {
+		while (presenter->running && (presenter->queued == -1)) {
+			pthread_cond_wait(&presenter->cond, &presenter->mutex);
+		}
+		if (!presenter->running) {
+			break;
+		}
+		presenter->presenting = presenter->queued;
+		presenter->queued = -1;
+		pthread_mutex_unlock(&presenter->mutex);
+
+		/* Neither of the two buffers can be handed out for rendering
+		 * while they're in the presenting or displayed state */
+		struct cairo_swbuf_t *swbuf = presenter->buffers[presenter->presenting];
+		const struct cairo_swbuf_t *displayed = (presenter->displayed == -1) ? NULL : presenter->buffers[presenter->displayed];
+		swbuf_get_damage_since(swbuf, displayed, &presenter->damage);
+		if (presenter->damage.rect_count) {
+			if (presenter->upscale.pixels) {
+				struct display_rect_t rects[SWBUF_MAX_DAMAGE_RECTS];
+				const unsigned int rect_count = swbuf_damage_to_display_rects(&presenter->damage, presenter->upscale.margin, presenter->display, rects);
+				swbuf_upscale_rects(swbuf, rects, rect_count, presenter->upscale.pixels, presenter->upscale.image.stride, presenter->upscale.bilinear);
+				blit_image_rects_on_display(&presenter->upscale.image, rects, rect_count, presenter->display);
+			} else {
+				blit_swbuf_damage_on_display(swbuf, &presenter->damage, presenter->display);
+			}
+			display_commit(presenter->display);
+		}
+
+		pthread_mutex_lock(&presenter->mutex);
+		presenter->displayed = presenter->presenting;
+		presenter->presenting = -1;
+		presenter->stats.frames_presented++;
+	}
+	pthread_mutex_unlock(&presenter->mutex);
+
+	/* Drivers may tie resources to the thread that draws to the display */
+	display_release(presenter->display);
+	return NULL;
+}
+
+/* Frames are rendered at render_scale times the display resolution */
+static bool presenter_init_upscale(struct presenter_t *presenter, double render_scale) {
+	presenter->upscale.scale = render_scale;
+	if (render_scale == 1) {
+		return true;
+	}
+
+	const unsigned int bits_per_pixel = swbuf_get_bits_per_pixel(presenter->buffers[0]);
+	const unsigned int stride = presenter->display->width * (bits_per_pixel / 8);
+	presenter->upscale.pixels = calloc(stride, presenter->display->height);
+	if (!presenter->upscale.pixels) {
+		perror("calloc");
+		return false;
+	}
+	presenter->upscale.image = (struct display_image_t) {
+		.pixels = presenter->upscale.pixels,
+		.width = presenter->display->width,
+		.height = presenter->display->height,
+		.stride = stride,
+		.bits_per_pixel = bits_per_pixel,
+	};
+
+	/* A changed low resolution pixel reaches further into the upscaled
+	 * image than the damaged area itself, by one source pixel for the
+	 * rounding of the damage and another for the filter kernel */
+	presenter->upscale.bilinear = (bits_per_pixel == 32);
+	presenter->upscale.margin = ceil((presenter->upscale.bilinear ? 2 : 1) / render_scale);
+	return true;
+}
+
+struct presenter_t *presenter_init(struct display_t *display, double render_scale) {
+	struct presenter_t *presenter = calloc(sizeof(struct presenter_t), 1);
+	if (!presenter) {
+		perror("calloc");
+		return NULL;
+	}
+
+	presenter->display = display;
+	presenter->rendering = -1;
+	presenter->queued = -1;
+	presenter->presenting = -1;
+	presenter->displayed = -1;
+	for (unsigned int i = 0; i < PRESENTER_BUFFER_COUNT; i++) {
+		presenter->buffers[i] = create_swbuf_scaled(display->width, display->height, display->bits_per_pixel, render_scale);
+		if (!presenter->buffers[i]) {
+			presenter_free(presenter);
+			return NULL;
+		}
+	}
+	if (!presenter_init_upscale(presenter, render_scale)) {
+		presenter_free(presenter);
+		return NULL;
+	}
+
+	pthread_mutex_init(&presenter->mutex, NULL);
+	pthread_cond_init(&presenter->cond, NULL);
+	presenter->running = true;
+	if (pthread_create(&presenter->present_thread, NULL, presenter_thread_fnc, presenter)) {
+		perror("pthread_create");
+		presenter->running = false;
+		presenter_free(presenter);
+		return NULL;
+	}
+	return presenter;
+}
+
+bool presenter_set_tiling(struct presenter_t *presenter, struct workpool_t *workers, unsigned int band_count) {
+	bool success = true;
+	presenter->tiling_workers = workers;
+	presenter->tiling_band_count = band_count;
+	for (unsigned int i = 0; i < PRESENTER_BUFFER_COUNT; i++) {
+		success = swbuf_set_tiling(presenter->buffers[i], workers, band_count) && success;
+	}
+	for (unsigned int i = 0; i < PRESENTER_MAX_DIRECT_PAGES; i++) {
+		if (presenter->direct.buffers[i]) {
+			success = swbuf_set_tiling(presenter->direct.buffers[i], workers, band_count) && success;
+		}
+	}
+	return success;
+}
+
+/* Must be called before the first frame is acquired. Returns false if the
+ * display has no page that could be rendered into directly; the presenter
+ * then keeps copying frames. Frames that need upscaling can never be rendered
+ * directly. */
+bool presenter_set_direct(struct presenter_t *presenter, bool enabled) {
+	struct display_draw_buffer_t draw_buffer;
+	if (enabled && presenter->upscale.pixels) {
+		enabled = false;
+	} else if (enabled && !display_get_draw_buffer(presenter->display, &draw_buffer)) {
+		enabled = false;
+	}
+	presenter->direct.enabled = enabled;
+	return enabled;
+}
+
+/* Every display page gets a swbuf of its own, so that damage tracking only
+ * repaints what has changed since the last frame rendered into that page. */
+static struct cairo_swbuf_t *presenter_acquire_direct(struct presenter_t *presenter) {
+	struct display_draw_buffer_t draw_buffer;
+	if (!display_get_draw_buffer(presenter->display, &draw_buffer) || (draw_buffer.page >= PRESENTER_MAX_DIRECT_PAGES)) {
+		fprintf(stderr, "Display no longer offers a page to render into, copying frames instead.\n");
+		presenter->direct.enabled = false;
+		return NULL;
+	}
+
+	struct cairo_swbuf_t **swbuf = &presenter->direct.buffers[draw_buffer.page];
+	if (*swbuf && (swbuf_get_pixel_data(*swbuf) != draw_buffer.pixels)) {
+		free_swbuf(*swbuf);
+		*swbuf = NULL;
+	}
+	if (!*swbuf) {
+		*swbuf = create_swbuf_for_data(draw_buffer.pixels, presenter->display->width, presenter->display->height, draw_buffer.stride, presenter->display->bits_per_pixel);
+		if (!*swbuf) {
+			presenter->direct.enabled = false;
+			return NULL;
+		}
+		swbuf_set_tiling(*swbuf, presenter->tiling_workers, presenter->tiling_band_count);
+	}
+	presenter->direct.rendering = *swbuf;
+	return *swbuf;
+}
+
+/* Never blocks: if no buffer is free because the present thread is still busy
+ * with an earlier frame, the frame that is queued but not yet presented is
+ * dropped and its buffer reused. */
+struct cairo_swbuf_t *presenter_acquire(struct presenter_t *presenter) {
+	if (presenter->direct.enabled) {
+		struct cairo_swbuf_t *swbuf = presenter_acquire_direct(presenter);
+		if (swbuf) {
+			return swbuf;
+		}
+	}
+
+	pthread_mutex_lock(&presenter->mutex);
+	int index = -1;
+	for (int i = 0; i < PRESENTER_BUFFER_COUNT; i++) {
+		if ((i != presenter->queued) && (i != presenter->presenting) && (i != presenter->displayed)) {
+			index = i;
+			break;
+		}
+	}
+	if (index == -1) {
+		index = presenter->queued;
+		presenter->queued = -1;
+		presenter->stats.frames_dropped++;
+	}
+	presenter->rendering = index;
+	pthread_mutex_unlock(&presenter->mutex);
+	return presenter->buffers[index];
+}
+
+/* Hands the most recently acquired buffer over to the present thread */
+void presenter_submit(struct presenter_t *presenter) {
+	if (presenter->direct.rendering) {
+		/* The frame is already in display memory, only needs to be flipped to */
+		presenter->direct.rendering = NULL;
+		display_commit(presenter->display);
+		pthread_mutex_lock(&presenter->mutex);
+		presenter->stats.frames_submitted++;
+		presenter->stats.frames_presented++;
+		pthread_mutex_unlock(&presenter->mutex);
+		return;
+	}
+
+	pthread_mutex_lock(&presenter->mutex);
+	if (presenter->rendering != -1) {
+		presenter->queued = presenter->rendering;
+		presenter->rendering = -1;
+		presenter->stats.frames_submitted++;
+		pthread_cond_broadcast(&presenter->cond);
+	}
+	pthread_mutex_unlock(&presenter->mutex);
+}
+
+void presenter_get_stats(struct presenter_t *presenter, struct presenter_stats_t *stats) {
+	pthread_mutex_lock(&presenter->mutex);
+	*stats = presenter->stats;
+	pthread_mutex_unlock(&presenter->mutex);
+}
+
+void presenter_free(struct presenter_t *presenter) {
+	if (!presenter) {
+		return;
+	}
+	if (presenter->running) {
+		pthread_mutex_lock(&presenter->mutex);
+		presenter->running = false;
+		pthread_cond_broadcast(&presenter->cond);
+		pthread_mutex_unlock(&presenter->mutex);
+		pthread_join(presenter->present_thread, NULL);
+	}
+	for (unsigned int i = 0; i < PRESENTER_BUFFER_COUNT; i++) {
+		free_swbuf(presenter->buffers[i]);
+	}
+	for (unsigned int i = 0; i < PRESENTER_MAX_DIRECT_PAGES; i++) {
+		free_swbuf(presenter->direct.buffers[i]);
+	}
+	free(presenter->upscale.pixels);
+	free(presenter);
+}
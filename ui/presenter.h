@@ -0,0 +1,83 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#ifndef __PRESENTER_H__
+#define __PRESENTER_H__
+
+#include <stdbool.h>
+#include <pthread.h>
+#include "display.h"
+#include "cairo.h"
+
+#define PRESENTER_BUFFER_COUNT		3
+#define PRESENTER_MAX_DIRECT_PAGES	2
+
+struct presenter_stats_t {
+	unsigned long frames_submitted;
+	unsigned long frames_presented;
+	unsigned long frames_dropped;
+};
+
+/* Copies finished frames out to the display on a thread of its own. Of the
+ * ring of buffers, one is shown on the display, one is being presented or
+ * queued for presentation and one is being rendered into. In direct mode,
+ * frames are instead rendered straight into the display's back page and
+ * flipped to by the rendering thread, without any copy. With a render scale
+ * other than 1, frames are rendered at reduced resolution and the present
+ * thread upscales what has changed into a display sized staging image. */
+struct presenter_t {
+	struct display_t *display;
+	struct cairo_swbuf_t *buffers[PRESENTER_BUFFER_COUNT];
+	pthread_t present_thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	bool running;
+	int rendering, queued, presenting, displayed;
+	struct {
+		bool enabled;
+		struct cairo_swbuf_t *buffers[PRESENTER_MAX_DIRECT_PAGES];
+		struct cairo_swbuf_t *rendering;
+	} direct;
+	struct {
+		double scale;
+		bool bilinear;
+		unsigned int margin;
+		uint8_t *pixels;
+		struct display_image_t image;
+	} upscale;
+	struct workpool_t *tiling_workers;
+	unsigned int tiling_band_count;
+	struct swbuf_damage_t damage;
+	struct presenter_stats_t stats;
+};
+
+/*************** AUTO GENERATED SECTION FOLLOWS ***************/
+struct presenter_t *presenter_init(struct display_t *display, double render_scale);
+bool presenter_set_tiling(struct presenter_t *presenter, struct workpool_t *workers, unsigned int band_count);
+bool presenter_set_direct(struct presenter_t *presenter, bool enabled);
+struct cairo_swbuf_t *presenter_acquire(struct presenter_t *presenter);
+void presenter_submit(struct presenter_t *presenter);
+void presenter_get_stats(struct presenter_t *presenter, struct presenter_stats_t *stats);
+void presenter_free(struct presenter_t *presenter);
+/***************  AUTO GENERATED SECTION ENDS   ***************/
+
+#endif
@@ -0,0 +1,70 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "renderer.h"
+#include "renderer_fullhd.h"
+#include "renderer_display.h"
+
+/* Ordered from largest to smallest resolution */
+static const struct renderer_t renderers[] = {
+	{
+		.name = "fullhd",
+		.width = 1920,
+		.height = 1080,
+		.state_size = sizeof(struct renderer_fullhd_state_t),
+		.render = swbuf_render_full_hd,
+	},
+	{
+		.name = "small",
+		.width = 320,
+		.height = 240,
+		.render = swbuf_render_small_display,
+	},
+};
+#define RENDERER_COUNT		(sizeof(renderers) / sizeof(struct renderer_t))
+
+const struct renderer_t *renderer_find(const char *name) {
+	for (unsigned int i = 0; i < RENDERER_COUNT; i++) {
+		if (!strcmp(renderers[i].name, name)) {
+			return &renderers[i];
+		}
+	}
+	fprintf(stderr, "No such renderer: %s (available:", name);
+	for (unsigned int i = 0; i < RENDERER_COUNT; i++) {
+		fprintf(stderr, " %s", renderers[i].name);
+	}
+	fprintf(stderr, ")\n");
+	return NULL;
+}
+
+/* Picks the largest layout that fits onto the display, or the smallest one if
+ * none does */
+const struct renderer_t *renderer_for_display(unsigned int width, unsigned int height) {
+	for (unsigned int i = 0; i < RENDERER_COUNT; i++) {
+		if ((renderers[i].width <= width) && (renderers[i].height <= height)) {
+			return &renderers[i];
+		}
+	}
+	return &renderers[RENDERER_COUNT - 1];
+}
@@ -0,0 +1,46 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#ifndef __RENDERER_H__
+#define __RENDERER_H__
+
+#include <stddef.h>
+#include "cyberblades-ui.h"
+#include "cairo.h"
+
+/* A screen layout, designed for one particular display resolution. What a
+ * layout carries over from one frame to the next is kept in a state of
+ * state_size bytes, of which every output has its own zero-initialized
+ * copy. */
+struct renderer_t {
+	const char *name;
+	unsigned int width, height;
+	size_t state_size;
+	void (*render)(const struct ui_state_t *ui_state, struct cairo_swbuf_t *swbuf, void *state);
+};
+
+/*************** AUTO GENERATED SECTION FOLLOWS ***************/
+const struct renderer_t *renderer_find(const char *name);
+const struct renderer_t *renderer_for_display(unsigned int width, unsigned int height);
+/***************  AUTO GENERATED SECTION ENDS   ***************/
+
+#endif
@@ -1,6 +1,33 @@
-static void swbuf_render_small_display(const struct server_state_t *server_state, struct cairo_swbuf_t *swbuf) {
-	swbuf_clear(swbuf, COLOR_BS_DARKBLUE);
-	if (server_state->ui_screen == MAIN_SCREEN) {
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#include "renderer_display.h"
+#include "cyberblades-ui.h"
+#include "cairo.h"
+#include "historian.h"
+
+void swbuf_render_small_display(const struct ui_state_t *ui_state, struct cairo_swbuf_t *swbuf, void *state) {
+	swbuf_begin_frame(swbuf, COLOR_BS_DARKBLUE);
+	if (ui_state->ui_screen == MAIN_SCREEN) {
 		const int cyberblades_offset = -5;
 		swbuf_text(swbuf, &(const struct font_placement_t) {
 			.font_face = "Beon",
@@ -65,7 +92,7 @@ static void swbuf_render_small_display(const struct server_state_t *server_state
 				},
 				.yoffset = -3,
 			};
-			switch (server_state->historian->connection_state) {
+			switch (ui_state->historian_state) {
 				case UNCONNECTED:
 					swbuf_rect(swbuf, &(const struct rect_placement_t){
 						.placement = rect_placement,
@@ -78,34 +105,34 @@ static void swbuf_render_small_display(const struct server_state_t *server_state
 					swbuf_text(swbuf, &text_placement, "Historian unavailable");
 					break;
 
-				case CONNECTED_WAITING:
-					swbuf_rect(swbuf, &(const struct rect_placement_t){
-						.placement = rect_placement,
-						.color = COLOR_SUN_FLOWER,
-						.fill = true,
-						.round = 10,
-						.width = 200,
-						.height = 25,
-					});
-					text_placement.font_color = COLOR_BLACK;
-					swbuf_text(swbuf, &text_placement, "Unconnected");
-					break;
-
-				case CONNECTED_READY:
-					swbuf_rect(swbuf, &(const struct rect_placement_t){
-						.placement = rect_placement,
-						.color = COLOR_EMERLAND,
-						.fill = true,
-						.round = 10,
-						.width = 200,
-						.height = 25,
-					});
-					swbuf_text(swbuf, &text_placement, "Ready for action");
+				case CONNECTED:
+					if (!ui_state->connected_to_beatsaber) {
+						swbuf_rect(swbuf, &(const struct rect_placement_t){
+							.placement = rect_placement,
+							.color = COLOR_SUN_FLOWER,
+							.fill = true,
+							.round = 10,
+							.width = 200,
+							.height = 25,
+						});
+						text_placement.font_color = COLOR_BLACK;
+						swbuf_text(swbuf, &text_placement, "Unconnected");
+					} else {
+						swbuf_rect(swbuf, &(const struct rect_placement_t){
+							.placement = rect_placement,
+							.color = COLOR_EMERLAND,
+							.fill = true,
+							.round = 10,
+							.width = 200,
+							.height = 25,
+						});
+						swbuf_text(swbuf, &text_placement, "Ready for action");
+					}
 					break;
 			}
 		}
 
-		if (server_state->current_player[0]) {
+		if (ui_state->player.name[0]) {
 			swbuf_text(swbuf, &(const struct font_placement_t){
 				.font_face = "Roboto",
 				.font_size = 22,
@@ -122,7 +149,7 @@ static void swbuf_render_small_display(const struct server_state_t *server_state
 					.yoffset = 65 + 25 * 0,
 				}
 
-			}, "Player: %s", server_state->current_player);
+			}, "Player: %s", ui_state->player.name);
 		} else {
 			swbuf_text(swbuf, &(const struct font_placement_t){
 				.font_face = "Roboto",
@@ -158,7 +185,7 @@ static void swbuf_render_small_display(const struct server_state_t *server_state
 				.yoffset = 65 + 25 * 1,
 			}
 
-		}, "Playtime: %2d:%02d", server_state->current_playtime / 60, server_state->current_playtime % 60);
+		}, "Playtime: %2d:%02d", ui_state->player.today.total_playtime_secs / 60, ui_state->player.today.total_playtime_secs % 60);
 
 		swbuf_text(swbuf, &(const struct font_placement_t){
 			.font_face = "Roboto",
@@ -176,9 +203,9 @@ static void swbuf_render_small_display(const struct server_state_t *server_state
 				.yoffset = 65 + 25 * 2,
 			}
 
-		}, "Scoresum: %.1f k", server_state->total_score / 1000.);
+		}, "Scoresum: %.1f k", ui_state->player.today.total_score / 1000.);
 
-	} if (server_state->ui_screen == GAME_SCREEN) {
+	} if (ui_state->ui_screen == GAME_SCREEN) {
 		{
 			const struct font_placement_t placement = {
 				.font_face = "Beon",
@@ -213,7 +240,7 @@ static void swbuf_render_small_display(const struct server_state_t *server_state
 				},
 				.yoffset = 65,
 			}
-		}, "%ld", server_state->current_score);
+		}, "%u", ui_state->current_song.performance.score);
 		swbuf_text(swbuf, &(const struct font_placement_t){
 			.font_face = "Digital Dream Fat",
 			.font_size = 20,
@@ -229,7 +256,8 @@ static void swbuf_render_small_display(const struct server_state_t *server_state
 				},
 				.yoffset = 65 + 32,
 			}
-		}, "%.1f%%", server_state->current_maxscore ? 100. * server_state->current_score / server_state->current_maxscore : 0);
-	} if (server_state->ui_screen == FINISH_SCREEN) {
+		}, "%.1f%%", ui_state->current_song.performance.max_score ? 100. * ui_state->current_song.performance.score / ui_state->current_song.performance.max_score : 0);
+	} if (ui_state->ui_screen == FINISH_SCREEN) {
 	}
+	swbuf_end_frame(swbuf);
 }
@@ -29,6 +29,8 @@
 #define STR_ENDASH								"–"
 #define STR_EMDASH								"—"
 
+#define LAYER_KEY(screen, variant)				(((screen) << 16) | (variant))
+
 #define FONT_HEADING_SIZE						128
 #define FONT_HEADING							.font_face = "Beon", .font_size = FONT_HEADING_SIZE
 #define TEXT_PLACEMENT(xoff, yoff, color)		&(const struct font_placement_t) {		\
@@ -61,11 +63,11 @@ static void swbuf_render_heading(struct cairo_swbuf_t *swbuf, const char *text)
 	}, text);
 }
 
-static void swbuf_render_main_screen_bottom_box(const struct server_state_t *server_state, struct cairo_swbuf_t *swbuf) {
+static void swbuf_render_main_screen_bottom_box(const struct ui_state_t *ui_state, struct cairo_swbuf_t *swbuf) {
 	uint32_t fgcolor, bgcolor;
 	const char *text = NULL;
 
-	switch (server_state->historian->connection_state) {
+	switch (ui_state->historian_state) {
 		case UNCONNECTED:
 			fgcolor = COLOR_WHITE;
 			bgcolor = COLOR_POMEGRANATE;
@@ -73,7 +75,7 @@ static void swbuf_render_main_screen_bottom_box(const struct server_state_t *ser
 			break;
 
 		case CONNECTED:
-			if (!server_state->connected_to_beatsaber) {
+			if (!ui_state->connected_to_beatsaber) {
 				fgcolor = COLOR_BLACK;
 				bgcolor = COLOR_SUN_FLOWER;
 				text = "Not connected to BeatSaber";
@@ -143,7 +145,7 @@ static void render_highscore_table_entry(char *dest_buf, unsigned int dest_buf_l
 }
 
 static void render_highscore_table(char *dest_buf, unsigned int dest_buf_length, struct font_placement_t *placement, unsigned int x, unsigned int y, void *ctx) {
-	const struct server_state_t *server_state = (const struct server_state_t*)ctx;
+	const struct ui_state_t *ui_state = (const struct ui_state_t*)ctx;
 
 	if (y == 0) {
 		const char *column_headings[] = {
@@ -165,11 +167,11 @@ static void render_highscore_table(char *dest_buf, unsigned int dest_buf_length,
 	}
 
 	const unsigned int highscore_index = y - 1;
-	if (highscore_index >= server_state->highscores.entry_count) {
+	if (highscore_index >= ui_state->highscores.entry_count) {
 		return;
 	}
 
-	const struct highscore_entry_t *highscore_entry = &server_state->highscores.entries[highscore_index];
+	const struct highscore_entry_t *highscore_entry = &ui_state->highscores.entries[highscore_index];
 
 	if (!highscore_entry->performance.verdict_passed) {
 		placement->font_color = COLOR_ASBESTOS;
@@ -192,7 +194,50 @@ static const char *difficulty_str(enum difficulty_level_t difficulty) {
 	return "?";
 }
 
-static void swbuf_render_main_screen(const struct server_state_t *server_state, struct cairo_swbuf_t *swbuf) {
+static void swbuf_render_highscore_table(const struct ui_state_t *ui_state, struct cairo_swbuf_t *swbuf, unsigned int first_row, unsigned int rows) {
+	const struct table_definition_t table = {
+		.rows = rows,
+		.first_row = first_row,
+		.columns = 8,
+		.row_height = 45,
+		.column_widths = (unsigned int[]) { 100, 250, 200, 150, 150, 150, 150, 100 },
+		.anchor = {
+			 .src_anchor = {
+				.x = XPOS_CENTER,
+				.y = YPOS_TOP,
+			},
+			.dst_anchor = {
+				.x = XPOS_CENTER,
+				.y = YPOS_TOP,
+			},
+			.xoffset = 0,
+			.yoffset = 420,
+		},
+		.rendering_callback = render_highscore_table,
+		.font_default = {
+			.font_face = "Roboto",
+			.font_size = 40,
+			.font_color = COLOR_CLOUDS,
+		},
+	};
+	swbuf_render_table(swbuf, &table, (void*)ui_state);
+}
+
+static uint32_t main_screen_layer_key(const struct ui_state_t *ui_state) {
+	uint32_t variant = 0;
+	if (ui_state->player.name[0]) {
+		variant |= (1 << 0);
+	}
+	if (ui_state->historian_state == CONNECTED) {
+		variant |= (1 << 1);
+	}
+	if (ui_state->connected_to_beatsaber) {
+		variant |= (1 << 2);
+	}
+	return LAYER_KEY(MAIN_SCREEN, variant);
+}
+
+static void swbuf_render_main_screen_static(const struct ui_state_t *ui_state, struct cairo_swbuf_t *swbuf) {
 	const int cyberblades_offset = -5;
 	swbuf_text(swbuf, &(const struct font_placement_t) {
 		FONT_HEADING,
@@ -215,7 +260,29 @@ static void swbuf_render_main_screen(const struct server_state_t *server_state,
 		}
 	}, "Blades");
 
-	if (server_state->player.name[0]) {
+	if (ui_state->player.name[0]) {
+		swbuf_text(swbuf, TEXT_PLACEMENT(-360 * 2, 200 + 45 * 2, COLOR_CLOUDS), "Playtime");
+		swbuf_text(swbuf, TEXT_PLACEMENT(-360 * 1, 200 + 45 * 2, COLOR_CLOUDS), "Notes Cut");
+		swbuf_text(swbuf, TEXT_PLACEMENT(0, 200 + 45 * 2, COLOR_CLOUDS), "Games Played");
+		swbuf_text(swbuf, TEXT_PLACEMENT(360 * 1, 200 + 45 * 2, COLOR_CLOUDS), "Total Score");
+		swbuf_text(swbuf, TEXT_PLACEMENT(360 * 2, 200 + 45 * 2, COLOR_CLOUDS), "Percentage");
+
+		/* Column headings only */
+		swbuf_render_highscore_table(ui_state, swbuf, 0, 1);
+	} else {
+		swbuf_text(swbuf, TEXT_PLACEMENT(0, 200 + 45 * 0, COLOR_POMEGRANATE), "No player selected");
+	}
+
+	swbuf_render_main_screen_bottom_box(ui_state, swbuf);
+}
+
+static void swbuf_render_main_screen(const struct ui_state_t *ui_state, struct cairo_swbuf_t *swbuf) {
+	if (swbuf_begin_static_layer(swbuf, main_screen_layer_key(ui_state))) {
+		swbuf_render_main_screen_static(ui_state, swbuf);
+		swbuf_end_static_layer(swbuf);
+	}
+
+	if (ui_state->player.name[0]) {
 		const struct font_placement_t player_placement = {
 			.font_face = "Roboto",
 			.font_size = 40,
@@ -233,7 +300,7 @@ static void swbuf_render_main_screen(const struct server_state_t *server_state,
 				.yoffset = 200,
 			}
 		};
-		swbuf_text(swbuf, &player_placement, "%s", server_state->player.name);
+		swbuf_text(swbuf, &player_placement, "%s", ui_state->player.name);
 
 
 		const struct font_placement_t song_placement = {
@@ -253,80 +320,59 @@ static void swbuf_render_main_screen(const struct server_state_t *server_state,
 				.yoffset = 200,
 			}
 		};
-		if (server_state->highscores.song_key.song_title[0]) {
-			if (server_state->highscores.song_key.song_author[0]) {
-				swbuf_text(swbuf, &song_placement, "%s - %s (%s)", server_state->highscores.song_key.song_author, server_state->highscores.song_key.song_title, difficulty_str(server_state->highscores.song_key.difficulty));
+		if (ui_state->highscores.song_key.song_title[0]) {
+			if (ui_state->highscores.song_key.song_author[0]) {
+				swbuf_text(swbuf, &song_placement, "%s - %s (%s)", ui_state->highscores.song_key.song_author, ui_state->highscores.song_key.song_title, difficulty_str(ui_state->highscores.song_key.difficulty));
 			} else {
-				swbuf_text(swbuf, &song_placement, "%s (%s)", server_state->highscores.song_key.song_title, difficulty_str(server_state->highscores.song_key.difficulty));
+				swbuf_text(swbuf, &song_placement, "%s (%s)", ui_state->highscores.song_key.song_title, difficulty_str(ui_state->highscores.song_key.difficulty));
 			}
 		}
 
-		swbuf_text(swbuf, TEXT_PLACEMENT(-360 * 2, 200 + 45 * 2, COLOR_CLOUDS), "Playtime");
-		swbuf_text(swbuf, TEXT_PLACEMENT(-360 * 1, 200 + 45 * 2, COLOR_CLOUDS), "Notes Cut");
-		swbuf_text(swbuf, TEXT_PLACEMENT(0, 200 + 45 * 2, COLOR_CLOUDS), "Games Played");
-		swbuf_text(swbuf, TEXT_PLACEMENT(360 * 1, 200 + 45 * 2, COLOR_CLOUDS), "Total Score");
-		swbuf_text(swbuf, TEXT_PLACEMENT(360 * 2, 200 + 45 * 2, COLOR_CLOUDS), "Percentage");
-
-		swbuf_text(swbuf, TEXT_PLACEMENT(-360 * 2, 200 + 45 * 3, COLOR_CLOUDS), "%s", cformat_sbuf_time_secs(server_state->player.today.total_playtime_secs));
-		swbuf_text(swbuf, TEXT_PLACEMENT(-360 * 1, 200 + 45 * 3, COLOR_CLOUDS), "%s", cformat_sbuf_si_float((double)(server_state->player.today.total_passed_notes - server_state->player.today.total_missed_notes)));
-		swbuf_text(swbuf, TEXT_PLACEMENT(0, 200 + 45 * 3, COLOR_CLOUDS), "%u", server_state->player.today.games_played);
-		swbuf_text(swbuf, TEXT_PLACEMENT(360 * 1, 200 + 45 * 3, COLOR_CLOUDS), "%s", cformat_sbuf_si_float((double)server_state->player.today.total_score));
-		if (server_state->player.today.total_max_score) {
-			swbuf_text(swbuf, TEXT_PLACEMENT(360 * 2, 200 + 45 * 3, COLOR_CLOUDS), "%.1f%%", 100. * server_state->player.today.total_score / server_state->player.today.total_max_score);
+		swbuf_text(swbuf, TEXT_PLACEMENT(-360 * 2, 200 + 45 * 3, COLOR_CLOUDS), "%s", cformat_sbuf_time_secs(ui_state->player.today.total_playtime_secs));
+		swbuf_text(swbuf, TEXT_PLACEMENT(-360 * 1, 200 + 45 * 3, COLOR_CLOUDS), "%s", cformat_sbuf_si_float((double)(ui_state->player.today.total_passed_notes - ui_state->player.today.total_missed_notes)));
+		swbuf_text(swbuf, TEXT_PLACEMENT(0, 200 + 45 * 3, COLOR_CLOUDS), "%u", ui_state->player.today.games_played);
+		swbuf_text(swbuf, TEXT_PLACEMENT(360 * 1, 200 + 45 * 3, COLOR_CLOUDS), "%s", cformat_sbuf_si_float((double)ui_state->player.today.total_score));
+		if (ui_state->player.today.total_max_score) {
+			swbuf_text(swbuf, TEXT_PLACEMENT(360 * 2, 200 + 45 * 3, COLOR_CLOUDS), "%.1f%%", 100. * ui_state->player.today.total_score / ui_state->player.today.total_max_score);
 		} else {
 			swbuf_text(swbuf, TEXT_PLACEMENT(360 * 2, 200 + 45 * 3, COLOR_CLOUDS), STR_EMDASH);
 		}
 
-		swbuf_text(swbuf, TEXT_PLACEMENT(-360 * 2, 200 + 45 * 4, COLOR_CLOUDS), "%s", cformat_sbuf_time_secs(server_state->player.alltime.total_playtime_secs));
-		swbuf_text(swbuf, TEXT_PLACEMENT(-360 * 1, 200 + 45 * 4, COLOR_CLOUDS), "%s", cformat_sbuf_si_float((double)(server_state->player.alltime.total_passed_notes - server_state->player.alltime.total_missed_notes)));
-		swbuf_text(swbuf, TEXT_PLACEMENT(0, 200 + 45 * 4, COLOR_CLOUDS), "%u", server_state->player.alltime.games_played);
-		swbuf_text(swbuf, TEXT_PLACEMENT(360 * 1, 200 + 45 * 4, COLOR_CLOUDS), "%s", cformat_sbuf_si_float((double)server_state->player.alltime.total_score));
-		if (server_state->player.alltime.total_max_score) {
-			swbuf_text(swbuf, TEXT_PLACEMENT(360 * 2, 200 + 45 * 4, COLOR_CLOUDS), "%.1f%%", 100. * server_state->player.alltime.total_score / server_state->player.alltime.total_max_score);
+		swbuf_text(swbuf, TEXT_PLACEMENT(-360 * 2, 200 + 45 * 4, COLOR_CLOUDS), "%s", cformat_sbuf_time_secs(ui_state->player.alltime.total_playtime_secs));
+		swbuf_text(swbuf, TEXT_PLACEMENT(-360 * 1, 200 + 45 * 4, COLOR_CLOUDS), "%s", cformat_sbuf_si_float((double)(ui_state->player.alltime.total_passed_notes - ui_state->player.alltime.total_missed_notes)));
+		swbuf_text(swbuf, TEXT_PLACEMENT(0, 200 + 45 * 4, COLOR_CLOUDS), "%u", ui_state->player.alltime.games_played);
+		swbuf_text(swbuf, TEXT_PLACEMENT(360 * 1, 200 + 45 * 4, COLOR_CLOUDS), "%s", cformat_sbuf_si_float((double)ui_state->player.alltime.total_score));
+		if (ui_state->player.alltime.total_max_score) {
+			swbuf_text(swbuf, TEXT_PLACEMENT(360 * 2, 200 + 45 * 4, COLOR_CLOUDS), "%.1f%%", 100. * ui_state->player.alltime.total_score / ui_state->player.alltime.total_max_score);
 		} else {
 			swbuf_text(swbuf, TEXT_PLACEMENT(360 * 2, 200 + 45 * 4, COLOR_CLOUDS), STR_EMDASH);
 		}
 
-		const struct table_definition_t table = {
-			.rows = 1 + server_state->highscores.entry_count,
-			.columns = 8,
-			.row_height = 45,
-			.column_widths = (unsigned int[]) { 100, 250, 200, 150, 150, 150, 150, 100 },
-			.anchor = {
-				 .src_anchor = {
-					.x = XPOS_CENTER,
-					.y = YPOS_TOP,
-				},
-				.dst_anchor = {
-					.x = XPOS_CENTER,
-					.y = YPOS_TOP,
-				},
-				.xoffset = 0,
-				.yoffset = 420,
-			},
-			.rendering_callback = render_highscore_table,
-			.font_default = {
-				.font_face = "Roboto",
-				.font_size = 40,
-				.font_color = COLOR_CLOUDS,
-			},
-		};
-		swbuf_render_table(swbuf, &table, (void*)server_state);
-	} else {
-		swbuf_text(swbuf, TEXT_PLACEMENT(0, 200 + 45 * 0, COLOR_POMEGRANATE), "No player selected");
+		/* Highscore entries without the column headings */
+		swbuf_render_highscore_table(ui_state, swbuf, 1, 1 + ui_state->highscores.entry_count);
 	}
-
-	swbuf_render_main_screen_bottom_box(server_state, swbuf);
 }
 
-static void swbuf_render_game_screen(const struct server_state_t *server_state, struct cairo_swbuf_t *swbuf) {
-	static unsigned int last_score_width = 0;
+static void swbuf_render_game_screen_static(const struct ui_state_t *ui_state, struct cairo_swbuf_t *swbuf) {
 	swbuf_render_heading(swbuf, "Game On");
-	last_score_width = swbuf_text(swbuf, &(const struct font_placement_t){
+	swbuf_text(swbuf, TEXT_PLACEMENT(-360 * 2, 500, COLOR_CLOUDS), "Combo");
+	swbuf_text(swbuf, TEXT_PLACEMENT(-360, 500, COLOR_CLOUDS), "Missed Notes");
+	swbuf_text(swbuf, TEXT_PLACEMENT(0, 500, COLOR_CLOUDS), "Total Notes");
+	swbuf_text(swbuf, TEXT_PLACEMENT(360, 500, COLOR_CLOUDS), "Note Percentage");
+	swbuf_text(swbuf, TEXT_PLACEMENT(360 * 2, 500, COLOR_CLOUDS), "Max Combo");
+}
+
+static void swbuf_render_game_screen(const struct ui_state_t *ui_state, struct cairo_swbuf_t *swbuf, struct renderer_fullhd_state_t *state) {
+	if (swbuf_begin_static_layer(swbuf, LAYER_KEY(GAME_SCREEN, 0))) {
+		swbuf_render_game_screen_static(ui_state, swbuf);
+		swbuf_end_static_layer(swbuf);
+	}
+
+	state->last_score_width = swbuf_text(swbuf, &(const struct font_placement_t){
 		.font_face = "Instruction",
 		.font_size = 140,
 		.font_color = COLOR_SUN_FLOWER,
-		.last_width = last_score_width,
+		.last_width = state->last_score_width,
 		.max_width_deviation = 10,
 		.placement = {
 			.src_anchor = {
@@ -339,14 +385,13 @@ static void swbuf_render_game_screen(const struct server_state_t *server_state,
 			},
 			.yoffset = 200 + 96,
 		}
-	}, "%ld", server_state->current_song.performance.score);
+	}, "%ld", ui_state->current_song.performance.score);
 
-	static unsigned int last_percentage_width = 0;
-	last_percentage_width = swbuf_text(swbuf, &(const struct font_placement_t){
+	state->last_percentage_width = swbuf_text(swbuf, &(const struct font_placement_t){
 		.font_face = "Roboto",
 		.font_size = 80,
 		.font_color = COLOR_ORANGE,
-		.last_width = last_percentage_width,
+		.last_width = state->last_percentage_width,
 		.max_width_deviation = 10,
 		.placement = {
 			.src_anchor = {
@@ -360,13 +405,13 @@ static void swbuf_render_game_screen(const struct server_state_t *server_state,
 			.xoffset = 10 - 200,
 			.yoffset = 200 + 96 + 96,
 		}
-	}, "%.1f%%", server_state->current_song.performance.max_score ? 100. * server_state->current_song.performance.score / server_state->current_song.performance.max_score : 0);
+	}, "%.1f%%", ui_state->current_song.performance.max_score ? 100. * ui_state->current_song.performance.score / ui_state->current_song.performance.max_score : 0);
 
 	swbuf_text(swbuf, &(const struct font_placement_t){
 		.font_face = "Roboto",
 		.font_size = 80,
 		.font_color = COLOR_ORANGE,
-		.last_width = last_percentage_width,
+		.last_width = state->last_percentage_width,
 		.max_width_deviation = 10,
 		.placement = {
 			.src_anchor = {
@@ -380,31 +425,28 @@ static void swbuf_render_game_screen(const struct server_state_t *server_state,
 			.xoffset = 10 + 200,
 			.yoffset = 200 + 96 + 96,
 		}
-	}, "%s", server_state->current_song.performance.rank[0] ? server_state->current_song.performance.rank : STR_EMDASH);
+	}, "%s", ui_state->current_song.performance.rank[0] ? ui_state->current_song.performance.rank : STR_EMDASH);
 
-	swbuf_text(swbuf, TEXT_PLACEMENT(-360 * 2, 500, COLOR_CLOUDS), "Combo");
-	swbuf_text(swbuf, TEXT_PLACEMENT(-360 * 2, 500 + 40, (server_state->current_song.performance.combo != server_state->current_song.performance.max_combo) ? COLOR_CLOUDS : COLOR_EMERLAND), "%d", server_state->current_song.performance.combo);
+	swbuf_text(swbuf, TEXT_PLACEMENT(-360 * 2, 500 + 40, (ui_state->current_song.performance.combo != ui_state->current_song.performance.max_combo) ? COLOR_CLOUDS : COLOR_EMERLAND), "%d", ui_state->current_song.performance.combo);
 
-	swbuf_text(swbuf, TEXT_PLACEMENT(-360, 500, COLOR_CLOUDS), "Missed Notes");
-	swbuf_text(swbuf, TEXT_PLACEMENT(-360, 500 + 40, server_state->current_song.performance.missed_notes ? COLOR_POMEGRANATE : COLOR_EMERLAND), "%d", server_state->current_song.performance.missed_notes);
+	swbuf_text(swbuf, TEXT_PLACEMENT(-360, 500 + 40, ui_state->current_song.performance.missed_notes ? COLOR_POMEGRANATE : COLOR_EMERLAND), "%d", ui_state->current_song.performance.missed_notes);
 
-	swbuf_text(swbuf, TEXT_PLACEMENT(0, 500, COLOR_CLOUDS), "Total Notes");
-	swbuf_text(swbuf, TEXT_PLACEMENT(0, 500 + 40, COLOR_CLOUDS), "%d", server_state->current_song.performance.passed_notes);
+	swbuf_text(swbuf, TEXT_PLACEMENT(0, 500 + 40, COLOR_CLOUDS), "%d", ui_state->current_song.performance.passed_notes);
 
-	swbuf_text(swbuf, TEXT_PLACEMENT(360, 500, COLOR_CLOUDS), "Note Percentage");
-	swbuf_text(swbuf, TEXT_PLACEMENT(360, 500 + 40, COLOR_CLOUDS), "%.1f%%", server_state->current_song.performance.passed_notes ? 100. * (server_state->current_song.performance.passed_notes - server_state->current_song.performance.missed_notes) / server_state->current_song.performance.passed_notes : 0);
+	swbuf_text(swbuf, TEXT_PLACEMENT(360, 500 + 40, COLOR_CLOUDS), "%.1f%%", ui_state->current_song.performance.passed_notes ? 100. * (ui_state->current_song.performance.passed_notes - ui_state->current_song.performance.missed_notes) / ui_state->current_song.performance.passed_notes : 0);
 
-	swbuf_text(swbuf, TEXT_PLACEMENT(360 * 2, 500, COLOR_CLOUDS), "Max Combo");
-	swbuf_text(swbuf, TEXT_PLACEMENT(360 * 2, 500 + 40, COLOR_CLOUDS), "%d", server_state->current_song.performance.max_combo);
+	swbuf_text(swbuf, TEXT_PLACEMENT(360 * 2, 500 + 40, COLOR_CLOUDS), "%d", ui_state->current_song.performance.max_combo);
 }
 
-void swbuf_render_full_hd(const struct server_state_t *server_state, struct cairo_swbuf_t *swbuf) {
-	swbuf_clear(swbuf, COLOR_BS_DARKBLUE);
-	if (server_state->ui_screen == MAIN_SCREEN) {
-		swbuf_render_main_screen(server_state, swbuf);
-	} if (server_state->ui_screen == GAME_SCREEN) {
-		swbuf_render_game_screen(server_state, swbuf);
+void swbuf_render_full_hd(const struct ui_state_t *ui_state, struct cairo_swbuf_t *swbuf, void *vstate) {
+	struct renderer_fullhd_state_t *state = (struct renderer_fullhd_state_t*)vstate;
+	swbuf_begin_frame(swbuf, COLOR_BS_DARKBLUE);
+	if (ui_state->ui_screen == MAIN_SCREEN) {
+		swbuf_render_main_screen(ui_state, swbuf);
+	} if (ui_state->ui_screen == GAME_SCREEN) {
+		swbuf_render_game_screen(ui_state, swbuf, state);
 
-	} if (server_state->ui_screen == FINISH_SCREEN) {
+	} if (ui_state->ui_screen == FINISH_SCREEN) {
 	}
+	swbuf_end_frame(swbuf);
 }
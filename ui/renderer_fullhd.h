@@ -26,8 +26,14 @@
 #include "cyberblades-ui.h"
 #include "cairo.h"
 
+/* Widths of the texts whose size is kept steady while their value changes */
+struct renderer_fullhd_state_t {
+	unsigned int last_score_width;
+	unsigned int last_percentage_width;
+};
+
 /*************** AUTO GENERATED SECTION FOLLOWS ***************/
-void swbuf_render_full_hd(const struct server_state_t *server_state, struct cairo_swbuf_t *swbuf);
+void swbuf_render_full_hd(const struct ui_state_t *ui_state, struct cairo_swbuf_t *swbuf, void *vstate);
 /***************  AUTO GENERATED SECTION ENDS   ***************/
 
 #endif
@@ -26,6 +26,7 @@
 #include <pthread.h>
 #include "ui_events.h"
 #include "signals.h"
+#include "eventloop.h"
 
 static ui_event_cb_t ui_event_callback;
 static void *ui_callback_ctx;
@@ -60,3 +61,22 @@ bool register_signal_handler(ui_event_cb_t event_callback, void *ctx) {
 	}
 	return true;
 }
+
+static void signal_eventloop_callback(struct eventloop_source_t *source, uint32_t events, void *ctx) {
+	while (eventloop_read_signal(source)) {
+		ui_event_callback(EVENT_QUIT, NULL, ui_callback_ctx);
+	}
+}
+
+/* Alternative to register_signal_handler() that delivers SIGINT through the
+ * event loop instead of a freshly spawned thread. Needs to be called before
+ * any other thread is created. */
+bool register_signal_eventloop(struct eventloop_t *eventloop, ui_event_cb_t event_callback, void *ctx) {
+	ui_event_callback = event_callback;
+	ui_callback_ctx = ctx;
+
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	return eventloop_add_signals(eventloop, &signals, signal_eventloop_callback, NULL) != NULL;
+}
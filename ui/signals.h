@@ -22,12 +22,14 @@
 
 #include <stdbool.h>
 #include "ui_events.h"
+#include "eventloop.h"
 
 #ifndef __SIGNALS_H__
 #define __SIGNALS_H__
 
 /*************** AUTO GENERATED SECTION FOLLOWS ***************/
 bool register_signal_handler(ui_event_cb_t event_callback, void *ctx);
+bool register_signal_eventloop(struct eventloop_t *eventloop, ui_event_cb_t event_callback, void *ctx);
 /***************  AUTO GENERATED SECTION ENDS   ***************/
 
 #endif
@@ -0,0 +1,191 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "textcache.h"
+
+static uint32_t fnv1a(uint32_t hash, const void *data, size_t length) {
+	const uint8_t *bytes = (const uint8_t*)data;
+	for (size_t i = 0; i < length; i++) {
+		hash = (hash ^ bytes[i]) * 16777619;
+	}
+	return hash;
+}
+
+static uint32_t textcache_hash(const struct textcache_key_t *key) {
+	uint32_t hash = 2166136261;
+	hash = fnv1a(hash, key->text, strlen(key->text));
+	hash = fnv1a(hash, key->font_face, strlen(key->font_face));
+	hash = fnv1a(hash, &key->font_size, sizeof(key->font_size));
+	hash = fnv1a(hash, &key->font_color, sizeof(key->font_color));
+	hash = fnv1a(hash, &key->font_bold, sizeof(key->font_bold));
+	return hash;
+}
+
+static bool textcache_entry_matches(const struct textcache_entry_t *entry, uint32_t hash, const struct textcache_key_t *key) {
+	return (entry->hash == hash) && (entry->font_size == key->font_size) && (entry->font_color == key->font_color)
+		&& (entry->font_bold == key->font_bold) && !strcmp(entry->text, key->text) && !strcmp(entry->font_face, key->font_face);
+}
+
+static void textcache_lru_unlink(struct textcache_t *cache, struct textcache_entry_t *entry) {
+	if (entry->lru_prev) {
+		entry->lru_prev->lru_next = entry->lru_next;
+	} else {
+		cache->lru_head = entry->lru_next;
+	}
+	if (entry->lru_next) {
+		entry->lru_next->lru_prev = entry->lru_prev;
+	} else {
+		cache->lru_tail = entry->lru_prev;
+	}
+	entry->lru_prev = NULL;
+	entry->lru_next = NULL;
+}
+
+static void textcache_lru_push_front(struct textcache_t *cache, struct textcache_entry_t *entry) {
+	entry->lru_prev = NULL;
+	entry->lru_next = cache->lru_head;
+	if (cache->lru_head) {
+		cache->lru_head->lru_prev = entry;
+	} else {
+		cache->lru_tail = entry;
+	}
+	cache->lru_head = entry;
+}
+
+static void textcache_remove(struct textcache_t *cache, struct textcache_entry_t *entry) {
+	struct textcache_entry_t **link = &cache->buckets[entry->hash % TEXTCACHE_BUCKETS];
+	while (*link && (*link != entry)) {
+		link = &(*link)->hash_next;
+	}
+	if (*link) {
+		*link = entry->hash_next;
+	}
+	textcache_lru_unlink(cache, entry);
+	cache->stats.entry_count--;
+	cache->stats.memory_used -= entry->memory_size;
+	cairo_surface_destroy(entry->run.surface);
+	free(entry->text);
+	free(entry);
+}
+
+static void textcache_evict(struct textcache_t *cache, size_t required_size) {
+	while (cache->lru_tail && (cache->stats.memory_used + required_size > cache->memory_limit)) {
+		textcache_remove(cache, cache->lru_tail);
+		cache->stats.evictions++;
+	}
+}
+
+/* On a hit, the run is copied to the caller who then holds an additional
+ * reference to its surface */
+bool textcache_lookup(struct textcache_t *cache, const struct textcache_key_t *key, struct textcache_run_t *run) {
+	uint32_t hash = textcache_hash(key);
+	pthread_mutex_lock(&cache->mutex);
+	cache->stats.lookups++;
+	struct textcache_entry_t *entry = cache->buckets[hash % TEXTCACHE_BUCKETS];
+	while (entry && !textcache_entry_matches(entry, hash, key)) {
+		entry = entry->hash_next;
+	}
+	if (entry) {
+		cache->stats.hits++;
+		textcache_lru_unlink(cache, entry);
+		textcache_lru_push_front(cache, entry);
+		*run = entry->run;
+		cairo_surface_reference(run->surface);
+	}
+	pthread_mutex_unlock(&cache->mutex);
+	return entry != NULL;
+}
+
+/* The cache takes its own reference of the run's surface. Runs that would
+ * take up more than a quarter of the memory limit are not cached at all. */
+bool textcache_insert(struct textcache_t *cache, const struct textcache_key_t *key, const struct textcache_run_t *run) {
+	cairo_surface_t *surface = run->surface;
+	size_t text_length = strlen(key->text);
+	size_t memory_size = sizeof(struct textcache_entry_t) + text_length + 1 + (cairo_image_surface_get_stride(surface) * cairo_image_surface_get_height(surface));
+	if (memory_size > cache->memory_limit / 4) {
+		return false;
+	}
+
+	struct textcache_entry_t *entry = calloc(1, sizeof(struct textcache_entry_t));
+	if (!entry) {
+		perror("calloc");
+		return false;
+	}
+	entry->text = malloc(text_length + 1);
+	if (!entry->text) {
+		perror("malloc");
+		free(entry);
+		return false;
+	}
+	memcpy(entry->text, key->text, text_length + 1);
+	strncpy(entry->font_face, key->font_face, sizeof(entry->font_face) - 1);
+	entry->font_size = key->font_size;
+	entry->font_color = key->font_color;
+	entry->font_bold = key->font_bold;
+	entry->hash = textcache_hash(key);
+	entry->memory_size = memory_size;
+	entry->run = *run;
+	cairo_surface_reference(entry->run.surface);
+
+	pthread_mutex_lock(&cache->mutex);
+	struct textcache_entry_t *existing = cache->buckets[entry->hash % TEXTCACHE_BUCKETS];
+	while (existing && !textcache_entry_matches(existing, entry->hash, key)) {
+		existing = existing->hash_next;
+	}
+	if (existing) {
+		/* Someone else was faster */
+		textcache_remove(cache, existing);
+	}
+	textcache_evict(cache, memory_size);
+	entry->hash_next = cache->buckets[entry->hash % TEXTCACHE_BUCKETS];
+	cache->buckets[entry->hash % TEXTCACHE_BUCKETS] = entry;
+	textcache_lru_push_front(cache, entry);
+	cache->stats.entry_count++;
+	cache->stats.memory_used += memory_size;
+	pthread_mutex_unlock(&cache->mutex);
+	return true;
+}
+
+void textcache_set_memory_limit(struct textcache_t *cache, size_t memory_limit) {
+	pthread_mutex_lock(&cache->mutex);
+	cache->memory_limit = memory_limit;
+	textcache_evict(cache, 0);
+	pthread_mutex_unlock(&cache->mutex);
+}
+
+void textcache_get_stats(struct textcache_t *cache, struct textcache_stats_t *stats) {
+	pthread_mutex_lock(&cache->mutex);
+	*stats = cache->stats;
+	stats->memory_limit = cache->memory_limit;
+	pthread_mutex_unlock(&cache->mutex);
+}
+
+void textcache_clear(struct textcache_t *cache) {
+	pthread_mutex_lock(&cache->mutex);
+	while (cache->lru_head) {
+		textcache_remove(cache, cache->lru_head);
+	}
+	pthread_mutex_unlock(&cache->mutex);
+}
@@ -0,0 +1,95 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#ifndef __TEXTCACHE_H__
+#define __TEXTCACHE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <cairo/cairo.h>
+
+#define TEXTCACHE_BUCKETS				256
+#define TEXTCACHE_DEFAULT_MEMORY_LIMIT	(16 * 1024 * 1024)
+
+struct textcache_key_t {
+	const char *font_face;
+	unsigned int font_size;
+	uint32_t font_color;
+	bool font_bold;
+	const char *text;
+};
+
+/* A pre-rasterized text run. The text origin lies at (pad - extents.x_bearing,
+ * pad - floor(extents.y_bearing)) within the surface. */
+struct textcache_run_t {
+	cairo_surface_t *surface;
+	unsigned int pad;
+	cairo_text_extents_t extents;
+	double font_ascent;
+};
+
+struct textcache_entry_t {
+	struct textcache_entry_t *hash_next;
+	struct textcache_entry_t *lru_prev, *lru_next;
+	uint32_t hash;
+	char font_face[64];
+	unsigned int font_size;
+	uint32_t font_color;
+	bool font_bold;
+	char *text;
+	size_t memory_size;
+	struct textcache_run_t run;
+};
+
+struct textcache_stats_t {
+	unsigned long lookups;
+	unsigned long hits;
+	unsigned long evictions;
+	unsigned int entry_count;
+	size_t memory_used;
+	size_t memory_limit;
+};
+
+struct textcache_t {
+	pthread_mutex_t mutex;
+	struct textcache_entry_t *buckets[TEXTCACHE_BUCKETS];
+	struct textcache_entry_t *lru_head, *lru_tail;
+	size_t memory_limit;
+	struct textcache_stats_t stats;
+};
+
+#define TEXTCACHE_INITIALIZER(limit)	{										\
+											.mutex = PTHREAD_MUTEX_INITIALIZER,	\
+											.memory_limit = (limit),			\
+										}
+
+/*************** AUTO GENERATED SECTION FOLLOWS ***************/
+bool textcache_lookup(struct textcache_t *cache, const struct textcache_key_t *key, struct textcache_run_t *run);
+bool textcache_insert(struct textcache_t *cache, const struct textcache_key_t *key, const struct textcache_run_t *run);
+void textcache_set_memory_limit(struct textcache_t *cache, size_t memory_limit);
+void textcache_get_stats(struct textcache_t *cache, struct textcache_stats_t *stats);
+void textcache_clear(struct textcache_t *cache);
+/***************  AUTO GENERATED SECTION ENDS   ***************/
+
+#endif
@@ -0,0 +1,79 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tribuf.h"
+
+#define TRIBUF_INDEX_MASK		0x3
+#define TRIBUF_FRESH			0x4
+
+struct tribuf_t *tribuf_init(size_t element_size, const void *initial_value) {
+	struct tribuf_t *tribuf = calloc(1, sizeof(struct tribuf_t));
+	if (!tribuf) {
+		perror("calloc");
+		return NULL;
+	}
+	tribuf->slots = calloc(3, element_size);
+	if (!tribuf->slots) {
+		perror("calloc");
+		free(tribuf);
+		return NULL;
+	}
+	tribuf->element_size = element_size;
+	if (initial_value) {
+		for (unsigned int i = 0; i < 3; i++) {
+			memcpy(tribuf->slots + (i * element_size), initial_value, element_size);
+		}
+	}
+	tribuf->write_index = 0;
+	tribuf->read_index = 1;
+	atomic_init(&tribuf->shared, 2);
+	return tribuf;
+}
+
+void *tribuf_write_slot(struct tribuf_t *tribuf) {
+	return tribuf->slots + (tribuf->write_index * tribuf->element_size);
+}
+
+void tribuf_publish(struct tribuf_t *tribuf) {
+	unsigned int previous = atomic_exchange(&tribuf->shared, tribuf->write_index | TRIBUF_FRESH);
+	tribuf->write_index = previous & TRIBUF_INDEX_MASK;
+}
+
+/* The returned slot stays valid and unchanged until the next call */
+const void *tribuf_read(struct tribuf_t *tribuf) {
+	if (atomic_load(&tribuf->shared) & TRIBUF_FRESH) {
+		unsigned int previous = atomic_exchange(&tribuf->shared, tribuf->read_index);
+		tribuf->read_index = previous & TRIBUF_INDEX_MASK;
+	}
+	return tribuf->slots + (tribuf->read_index * tribuf->element_size);
+}
+
+void tribuf_free(struct tribuf_t *tribuf) {
+	if (!tribuf) {
+		return;
+	}
+	free(tribuf->slots);
+	free(tribuf);
+}
@@ -0,0 +1,48 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#ifndef __TRIBUF_H__
+#define __TRIBUF_H__
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+/* Lock-free triple buffer for exactly one writer and one reader. The writer
+ * fills its private slot and publishes it, the reader always gets the most
+ * recently published slot. Neither side ever waits for the other. */
+struct tribuf_t {
+	size_t element_size;
+	unsigned char *slots;
+	unsigned int write_index;
+	unsigned int read_index;
+	atomic_uint shared;
+};
+
+/*************** AUTO GENERATED SECTION FOLLOWS ***************/
+struct tribuf_t *tribuf_init(size_t element_size, const void *initial_value);
+void *tribuf_write_slot(struct tribuf_t *tribuf);
+void tribuf_publish(struct tribuf_t *tribuf);
+const void *tribuf_read(struct tribuf_t *tribuf);
+void tribuf_free(struct tribuf_t *tribuf);
+/***************  AUTO GENERATED SECTION ENDS   ***************/
+
+#endif
@@ -48,6 +48,7 @@ struct historian_t;
 struct ui_event_historian_msg_t {
 	struct historian_t *historian;
 	struct jsondom_t* json;
+	unsigned int request_id;
 };
 
 struct ui_event_historian_statechg_t {
@@ -0,0 +1,258 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "uistate.h"
+#include "tools.h"
+
+static bool string_is(const char *str1, const char *str2) {
+	if (!str1 || !str2) {
+		return false;
+	}
+	return !strcmp(str1, str2);
+}
+
+static void parse_performance(struct performance_info_t *performance, struct jsondom_t *json) {
+	performance->score = jsondom_get_dict_int(json, "score");
+	performance->max_score = jsondom_get_dict_int(json, "max_score");
+	performance->combo = jsondom_get_dict_int(json, "combo");
+	performance->max_combo = jsondom_get_dict_int(json, "max_combo");
+	performance->hit_notes = jsondom_get_dict_int(json, "hit_notes");
+	performance->passed_notes = jsondom_get_dict_int(json, "passed_notes");
+	performance->missed_notes = jsondom_get_dict_int(json, "missed_notes");
+	const char *rank = jsondom_get_dict_str(json, "rank");
+	if (rank) {
+		strncpy(performance->rank, rank, sizeof(performance->rank) - 1);
+	} else {
+		performance->rank[0] = 0;
+	}
+	performance->verdict_passed = string_is(jsondom_get_dict_str(json, "verdict"), "pass");
+}
+
+static void parse_game_info(struct song_info_t *song, struct jsondom_t *song_json) {
+	struct jsondom_t *json_current_game_perf = jsondom_get_dict_dict(song_json, "performance");
+	if (json_current_game_perf) {
+		parse_performance(&song->performance, json_current_game_perf);
+	} else {
+		memset(&song->performance, 0, sizeof(song->performance));
+	}
+
+	struct jsondom_t *json_current_game_meta = jsondom_get_dict_dict(song_json, "meta");
+	if (json_current_game_meta) {
+		const char *song_author = jsondom_get_dict_str(json_current_game_meta, "song_author");
+		if (song_author) {
+			strncpy(song->meta.song_author, song_author, sizeof(song->meta.song_author) - 1);
+		}
+		const char *song_title = jsondom_get_dict_str(json_current_game_meta, "song_title");
+		if (song_title) {
+			strncpy(song->meta.song_title, song_title, sizeof(song->meta.song_title) - 1);
+		}
+		const char *level_author = jsondom_get_dict_str(json_current_game_meta, "level_author");
+		if (level_author) {
+			strncpy(song->meta.level_author, level_author, sizeof(song->meta.level_author) - 1);
+		}
+		if (jsondom_get_dict(json_current_game_meta, "difficulty")) {
+			song->meta.difficulty = jsondom_get_dict_int(json_current_game_meta, "difficulty");
+		}
+	}
+}
+
+/* Delta updates only touch the fields that are present; a value of null
+ * clears a field */
+static void update_uint(unsigned int *value, struct jsondom_t *json, const char *key) {
+	if (jsondom_get_dict(json, key)) {
+		*value = jsondom_get_dict_int(json, key);
+	}
+}
+
+static void update_str(char *dest, unsigned int dest_buffer_size, struct jsondom_t *json, const char *key) {
+	if (jsondom_get_dict(json, key)) {
+		strncpycmp(dest, jsondom_get_dict_str(json, key), dest_buffer_size);
+	}
+}
+
+static void update_performance(struct performance_info_t *performance, struct jsondom_t *json) {
+	update_uint(&performance->score, json, "score");
+	update_uint(&performance->max_score, json, "max_score");
+	update_uint(&performance->combo, json, "combo");
+	update_uint(&performance->max_combo, json, "max_combo");
+	update_uint(&performance->hit_notes, json, "hit_notes");
+	update_uint(&performance->passed_notes, json, "passed_notes");
+	update_uint(&performance->missed_notes, json, "missed_notes");
+	update_str(performance->rank, sizeof(performance->rank), json, "rank");
+	if (jsondom_get_dict(json, "verdict")) {
+		performance->verdict_passed = string_is(jsondom_get_dict_str(json, "verdict"), "pass");
+	}
+}
+
+static void update_game_info(struct song_info_t *song, struct jsondom_t *song_json) {
+	struct jsondom_t *json_current_game_perf = jsondom_get_dict(song_json, "performance");
+	if (json_current_game_perf) {
+		if (json_current_game_perf->elementtype == JD_DICT) {
+			update_performance(&song->performance, json_current_game_perf);
+		} else {
+			memset(&song->performance, 0, sizeof(song->performance));
+		}
+	}
+
+	struct jsondom_t *json_current_game_meta = jsondom_get_dict_dict(song_json, "meta");
+	if (json_current_game_meta) {
+		update_str(song->meta.song_author, sizeof(song->meta.song_author), json_current_game_meta, "song_author");
+		update_str(song->meta.song_title, sizeof(song->meta.song_title), json_current_game_meta, "song_title");
+		update_str(song->meta.level_author, sizeof(song->meta.level_author), json_current_game_meta, "level_author");
+		if (jsondom_get_dict(json_current_game_meta, "difficulty")) {
+			song->meta.difficulty = jsondom_get_dict_int(json_current_game_meta, "difficulty");
+		}
+	}
+}
+
+static void parse_player_stats(struct player_stats_t *stats, struct jsondom_t *stat_json) {
+	stats->games_played = jsondom_get_dict_int(stat_json, "games_played");
+	stats->total_playtime_secs = jsondom_get_dict_float(stat_json, "total_playtime_secs");
+	stats->total_passed_notes = jsondom_get_dict_int(stat_json, "total_passed_notes");
+	stats->total_missed_notes = jsondom_get_dict_int(stat_json, "total_missed_notes");
+	stats->total_score = jsondom_get_dict_int(stat_json, "total_score");
+	stats->total_max_score = jsondom_get_dict_int(stat_json, "total_max_score");
+}
+
+/* Applies a "status" message. Returns whether the player information needs to
+ * be (re-)requested from the historian afterwards. */
+enum playerinfo_refresh_t ui_state_apply_status(struct ui_state_t *state, struct jsondom_t *json) {
+	enum playerinfo_refresh_t request_player_information = PLAYERINFO_CURRENT;
+	struct jsondom_t *json_connection = jsondom_get_dict_dict(json, "connection");
+	struct jsondom_t *current_game = jsondom_get_dict_dict(json, "current_game");
+	if (json_connection) {
+		if (strncpycmp(state->player.name, jsondom_get_dict_str(json_connection, "current_player"), sizeof(state->player.name))) {
+			/* Player name has changed */
+			request_player_information = PLAYERINFO_PLAYER_CHANGED;
+		}
+		state->connected_to_beatsaber = jsondom_get_dict_bool(json_connection, "connected_to_beatsaber");
+
+		bool in_game = current_game != NULL;
+		if (in_game) {
+			state->ui_screen = GAME_SCREEN;
+			state->screen_shown_at_ts = now();
+		} else {
+			if (state->ui_screen == GAME_SCREEN) {
+				/* Was playing a game, now back to main screen: Update
+				 * highscores! */
+				request_player_information = PLAYERINFO_OUTDATED;
+			}
+			state->ui_screen = MAIN_SCREEN;
+			state->screen_shown_at_ts = now();
+		}
+	}
+
+	parse_game_info(&state->current_song, current_game);
+	return request_player_information;
+}
+
+/* Applies the "changes" of a "status_delta" message, which only contain what
+ * differs from the previous status update. A game that has started is sent
+ * in full, one that has ended as null. */
+enum playerinfo_refresh_t ui_state_apply_status_delta(struct ui_state_t *state, struct jsondom_t *changes) {
+	enum playerinfo_refresh_t request_player_information = PLAYERINFO_CURRENT;
+	struct jsondom_t *json_connection = jsondom_get_dict_dict(changes, "connection");
+	if (json_connection) {
+		if (jsondom_get_dict(json_connection, "current_player")) {
+			if (strncpycmp(state->player.name, jsondom_get_dict_str(json_connection, "current_player"), sizeof(state->player.name))) {
+				request_player_information = PLAYERINFO_PLAYER_CHANGED;
+			}
+		}
+		if (jsondom_get_dict(json_connection, "connected_to_beatsaber")) {
+			state->connected_to_beatsaber = jsondom_get_dict_bool(json_connection, "connected_to_beatsaber");
+		}
+	}
+
+	struct jsondom_t *current_game = jsondom_get_dict(changes, "current_game");
+	if (current_game) {
+		if (current_game->elementtype == JD_DICT) {
+			if (state->ui_screen != GAME_SCREEN) {
+				state->ui_screen = GAME_SCREEN;
+				state->screen_shown_at_ts = now();
+				memset(&state->current_song, 0, sizeof(state->current_song));
+			}
+			update_game_info(&state->current_song, current_game);
+		} else {
+			if (state->ui_screen == GAME_SCREEN) {
+				request_player_information = PLAYERINFO_OUTDATED;
+			}
+			state->ui_screen = MAIN_SCREEN;
+			state->screen_shown_at_ts = now();
+			parse_game_info(&state->current_song, NULL);
+		}
+	}
+	return request_player_information;
+}
+
+static void parse_highscore_entry(struct highscore_entry_t *entry, struct jsondom_t *json) {
+	strncpycmp(entry->name, jsondom_get_dict_str(json, "player"), sizeof(entry->name));
+	entry->number = jsondom_get_dict_int(json, "number");
+	entry->most_recent = jsondom_get_dict_bool(json, "most_recent");
+	parse_performance(&entry->performance, json);
+}
+
+/* Parses a "playerinfo" message. Returns false if it names no player. */
+bool ui_state_parse_playerinfo(struct jsondom_t *json, struct player_info_t *player, struct highscore_table_t *highscores) {
+	memset(player, 0, sizeof(*player));
+	memset(highscores, 0, sizeof(*highscores));
+	const char *player_name = jsondom_get_dict_str(json, "player");
+	if (!player_name) {
+		return false;
+	}
+	strncpycmp(player->name, player_name, sizeof(player->name));
+	parse_player_stats(&player->today, jsondom_get_dict_dict(json, "today"));
+	parse_player_stats(&player->alltime, jsondom_get_dict_dict(json, "alltime"));
+
+	struct jsondom_t *highscore = jsondom_get_dict_dict(json, "highscore");
+	struct jsondom_t *highscore_song_key = jsondom_get_dict_dict(highscore, "song_key");
+	if (highscore_song_key) {
+		strncpycmp(highscores->song_key.song_author, jsondom_get_dict_str(highscore_song_key, "song_author"), sizeof(highscores->song_key.song_author));
+		strncpycmp(highscores->song_key.song_title, jsondom_get_dict_str(highscore_song_key, "song_title"), sizeof(highscores->song_key.song_title));
+		strncpycmp(highscores->song_key.level_author, jsondom_get_dict_str(highscore_song_key, "level_author"), sizeof(highscores->song_key.level_author));
+		highscores->song_key.difficulty = jsondom_get_dict_int(highscore_song_key, "difficulty");
+	}
+
+	struct jsondom_t *highscore_table = jsondom_get_dict_array(highscore, "table");
+	if (highscore_table) {
+		unsigned int highscore_entry_count = highscore_table->element.array.element_cnt;
+		highscores->entry_count = (highscore_entry_count > MAX_HIGHSCORE_ENTRY_COUNT) ? MAX_HIGHSCORE_ENTRY_COUNT : highscore_entry_count;
+		for (unsigned int i = 0; i < highscores->entry_count; i++) {
+			struct jsondom_t *highscore_entry = jsondom_get_array_item(highscore_table, i);
+			parse_highscore_entry(&highscores->entries[i], highscore_entry);
+		}
+	}
+	return true;
+}
+
+/* Applies parsed or cached player information. Returns false if it was
+ * ignored because it refers to a player other than the current one. */
+bool ui_state_apply_playerinfo(struct ui_state_t *state, const struct player_info_t *player, const struct highscore_table_t *highscores) {
+	if (!player->name[0] || strcmp(player->name, state->player.name)) {
+		/* No player set or different player given */
+		return false;
+	}
+	state->player = *player;
+	state->highscores = *highscores;
+	return true;
+}
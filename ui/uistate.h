@@ -0,0 +1,43 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#ifndef __UISTATE_H__
+#define __UISTATE_H__
+
+#include <stdbool.h>
+#include "cyberblades-ui.h"
+#include "jsondom.h"
+
+enum playerinfo_refresh_t {
+	PLAYERINFO_CURRENT,
+	PLAYERINFO_PLAYER_CHANGED,
+	PLAYERINFO_OUTDATED,
+};
+
+/*************** AUTO GENERATED SECTION FOLLOWS ***************/
+enum playerinfo_refresh_t ui_state_apply_status(struct ui_state_t *state, struct jsondom_t *json);
+enum playerinfo_refresh_t ui_state_apply_status_delta(struct ui_state_t *state, struct jsondom_t *changes);
+bool ui_state_parse_playerinfo(struct jsondom_t *json, struct player_info_t *player, struct highscore_table_t *highscores);
+bool ui_state_apply_playerinfo(struct ui_state_t *state, const struct player_info_t *player, const struct highscore_table_t *highscores);
+/***************  AUTO GENERATED SECTION ENDS   ***************/
+
+#endif
@@ -0,0 +1,120 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "workpool.h"
+
+/* Must be called with the pool mutex held, returns with it held */
+static void workpool_work(struct workpool_t *pool) {
+	while (pool->next_job < pool->job_count) {
+		const unsigned int job_index = pool->next_job++;
+		pthread_mutex_unlock(&pool->mutex);
+		pool->job(pool->job_ctx, job_index);
+		pthread_mutex_lock(&pool->mutex);
+		pool->jobs_done++;
+		if (pool->jobs_done == pool->job_count) {
+			pthread_cond_broadcast(&pool->done_cond);
+		}
+	}
+}
+
+static void* workpool_thread_fnc(void *vpool) {
+	struct workpool_t *pool = (struct workpool_t*)vpool;
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->running) {
+		if (pool->next_job < pool->job_count) {
+			workpool_work(pool);
+		} else {
+			pthread_cond_wait(&pool->work_cond, &pool->mutex);
+		}
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+struct workpool_t *workpool_init(unsigned int worker_count) {
+	struct workpool_t *pool = calloc(sizeof(struct workpool_t), 1);
+	if (!pool) {
+		perror("calloc");
+		return NULL;
+	}
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->work_cond, NULL);
+	pthread_cond_init(&pool->done_cond, NULL);
+	pool->worker_count = worker_count ? worker_count : 1;
+	pool->running = true;
+
+	if (pool->worker_count > 1) {
+		pool->threads = calloc(sizeof(pthread_t), pool->worker_count - 1);
+		if (!pool->threads) {
+			perror("calloc");
+			workpool_free(pool);
+			return NULL;
+		}
+		for (unsigned int i = 0; i < pool->worker_count - 1; i++) {
+			if (pthread_create(&pool->threads[i], NULL, workpool_thread_fnc, pool)) {
+				perror("pthread_create");
+				workpool_free(pool);
+				return NULL;
+			}
+			pool->thread_count++;
+		}
+	}
+	return pool;
+}
+
+/* Runs job(ctx, 0) up to job(ctx, job_count - 1) distributed across all
+ * workers and returns once all of them have finished. Only one thread may
+ * run jobs on a pool at any time. */
+void workpool_run(struct workpool_t *pool, workpool_job_t job, void *ctx, unsigned int job_count) {
+	pthread_mutex_lock(&pool->mutex);
+	pool->job = job;
+	pool->job_ctx = ctx;
+	pool->job_count = job_count;
+	pool->next_job = 0;
+	pool->jobs_done = 0;
+	pthread_cond_broadcast(&pool->work_cond);
+
+	workpool_work(pool);
+	while (pool->jobs_done < pool->job_count) {
+		pthread_cond_wait(&pool->done_cond, &pool->mutex);
+	}
+	pool->job_count = 0;
+	pool->next_job = 0;
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void workpool_free(struct workpool_t *pool) {
+	if (!pool) {
+		return;
+	}
+	pthread_mutex_lock(&pool->mutex);
+	pool->running = false;
+	pthread_cond_broadcast(&pool->work_cond);
+	pthread_mutex_unlock(&pool->mutex);
+	for (unsigned int i = 0; i < pool->thread_count; i++) {
+		pthread_join(pool->threads[i], NULL);
+	}
+	free(pool->threads);
+	free(pool);
+}
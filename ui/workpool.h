@@ -0,0 +1,55 @@
+/*
+	pibeatsaber - Beat Saber historian application that tracks players
+	Copyright (C) 2019-2019 Johannes Bauer
+
+	This file is part of pibeatsaber.
+
+	pibeatsaber is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; this program is ONLY licensed under
+	version 3 of the License, later versions are explicitly excluded.
+
+	pibeatsaber is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	Johannes Bauer <JohannesBauer@gmx.de>
+*/
+
+#ifndef __WORKPOOL_H__
+#define __WORKPOOL_H__
+
+#include <stdbool.h>
+#include <pthread.h>
+
+typedef void (*workpool_job_t)(void *ctx, unsigned int job_index);
+
+/* Fixed set of threads that run numbered jobs. The thread calling
+ * workpool_run() counts as one of the workers and helps out, so a pool of
+ * one worker has no threads at all and runs everything inline. */
+struct workpool_t {
+	pthread_mutex_t mutex;
+	pthread_cond_t work_cond;
+	pthread_cond_t done_cond;
+	unsigned int worker_count;
+	unsigned int thread_count;
+	pthread_t *threads;
+	bool running;
+	workpool_job_t job;
+	void *job_ctx;
+	unsigned int job_count;
+	unsigned int next_job;
+	unsigned int jobs_done;
+};
+
+/*************** AUTO GENERATED SECTION FOLLOWS ***************/
+struct workpool_t *workpool_init(unsigned int worker_count);
+void workpool_run(struct workpool_t *pool, workpool_job_t job, void *ctx, unsigned int job_count);
+void workpool_free(struct workpool_t *pool);
+/***************  AUTO GENERATED SECTION ENDS   ***************/
+
+#endif